@@ -0,0 +1,149 @@
+/*
+ * congestion.cpp
+ */
+
+#include "congestion.h"
+
+std::unique_ptr<CongestionControl> CongestionControl::create(const std::string& name)
+{
+    if (name == "none")
+    {
+        return std::make_unique<NoControl>();
+    }
+    if (name == "reno")
+    {
+        return std::make_unique<RenoControl>();
+    }
+    if (name == "delay")
+    {
+        return std::make_unique<DelayControl>();
+    }
+    return nullptr;
+}
+
+void CongestionControl::reset()
+{
+    _cwnd = CC_INITIAL_WINDOW;
+    _ssthresh = CC_MAX_WINDOW;
+    _recovery_end = 0;
+}
+
+void CongestionControl::on_ack(uint32_t /* acked */, std::chrono::microseconds rtt)
+{
+    if (rtt.count() > 0)
+    {
+        _last_rtt = rtt;
+        _min_rtt = _min_rtt.count() > 0 ? std::min(_min_rtt, rtt) : rtt;
+    }
+}
+
+void CongestionControl::on_loss(uint32_t seq, uint32_t highest_sent)
+{
+    _losses++;
+
+    // Holes reported again while same flight is recovered
+    if (seq <= _recovery_end)
+    {
+        return;
+    }
+
+    _recovery_end = highest_sent;
+    reduce();
+
+    spdlog::info("[CongestionControl::on_loss] {} loss at fragment {}, window {} threshold {}", get_name(), seq, get_window(), static_cast<uint32_t>(_ssthresh));
+}
+
+void CongestionControl::on_timeout(uint32_t highest_sent)
+{
+    _timeouts++;
+    _recovery_end = highest_sent;
+    collapse();
+
+    spdlog::info("[CongestionControl::on_timeout] {} timeout, window {} threshold {}", get_name(), get_window(), static_cast<uint32_t>(_ssthresh));
+}
+
+void CongestionControl::reduce()
+{
+    _ssthresh = std::max(_cwnd / 2.0, static_cast<double>(CC_MIN_WINDOW));
+    _cwnd = _ssthresh;
+}
+
+void CongestionControl::collapse()
+{
+    _ssthresh = std::max(_cwnd / 2.0, static_cast<double>(CC_MIN_WINDOW));
+    _cwnd = CC_MIN_WINDOW;
+}
+
+uint32_t CongestionControl::get_window() const
+{
+    return static_cast<uint32_t>(std::clamp(_cwnd, static_cast<double>(CC_MIN_WINDOW), static_cast<double>(CC_MAX_WINDOW)));
+}
+
+std::string CongestionControl::report() const
+{
+    std::ostringstream out;
+    out << "congestion " << get_name()
+        << " window " << get_window()
+        << " threshold " << static_cast<uint32_t>(std::min(_ssthresh, static_cast<double>(CC_MAX_WINDOW)))
+        << " rtt " << _last_rtt.count() << " us"
+        << " min rtt " << _min_rtt.count() << " us"
+        << " losses " << _losses
+        << " timeouts " << _timeouts;
+
+    return out.str();
+}
+
+void RenoControl::on_ack(uint32_t acked, std::chrono::microseconds rtt)
+{
+    CongestionControl::on_ack(acked, rtt);
+
+    if (_cwnd < _ssthresh)
+    {
+        // Slow start, doubles every round trip
+        _cwnd += acked;
+    }
+    else
+    {
+        // Congestion avoidance, one fragment per round trip
+        _cwnd += static_cast<double>(acked) / _cwnd;
+    }
+
+    _cwnd = std::min(_cwnd, static_cast<double>(CC_MAX_WINDOW));
+}
+
+void DelayControl::on_ack(uint32_t acked, std::chrono::microseconds rtt)
+{
+    CongestionControl::on_ack(acked, rtt);
+
+    // Acknowledgments arrive once per window, so each fresh sample is one round trip
+    if (rtt.count() <= 0)
+    {
+        return;
+    }
+
+    // Fragments sitting in queues: expected minus actual rate, times base round trip
+    double growth = std::max<double>(0.0, static_cast<double>((rtt - _min_rtt).count() - CC_DELAY_TOLERANCE_US));
+    double queued = _cwnd * growth / static_cast<double>(rtt.count());
+
+    if (_cwnd < _ssthresh)
+    {
+        if (queued > CC_DELAY_GAMMA)
+        {
+            _ssthresh = _cwnd;
+        }
+        else
+        {
+            _cwnd += acked;
+        }
+    }
+    else if (queued < CC_DELAY_ALPHA)
+    {
+        _cwnd += 1.0;
+    }
+    else if (queued > CC_DELAY_BETA)
+    {
+        _cwnd -= 1.0;
+    }
+
+    _cwnd = std::clamp(_cwnd, static_cast<double>(CC_MIN_WINDOW), static_cast<double>(CC_MAX_WINDOW));
+}
@@ -0,0 +1,96 @@
+/*
+ * congestion.h — Congestion Window Controllers
+ *
+ * Controller decides how many fragments may be in flight, from acknowledgment
+ * and loss feedback. Window is counted in fragments. Losses within one recovery
+ * epoch (fragments in flight when first loss was seen) reduce window only once.
+ *
+ * Available controllers:
+ *  1) none  - no limit, only window size and retransmission buffer bound sending
+ *  2) reno  - AIMD, slow start, halves on loss
+ *  3) delay - Vegas style, keeps few fragments queued based on RTT growth over base RTT, halves on loss
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+#define CC_INITIAL_WINDOW       10          // Fragments in flight before first acknowledgment
+#define CC_MIN_WINDOW           2
+#define CC_MAX_WINDOW           4096        // Retransmission buffer length
+
+#define CC_DELAY_ALPHA          2.0         // Fewer fragments queued, window grows
+#define CC_DELAY_BETA           4.0         // More fragments queued, window shrinks
+#define CC_DELAY_GAMMA          1.0         // Slow start ends above this queue
+#define CC_DELAY_TOLERANCE_US   250         // Round trip growth below this is scheduling noise
+
+class CongestionControl {
+public:
+    virtual ~CongestionControl() = default;
+
+    /* Controller by name, nullptr when unknown */
+    static std::unique_ptr<CongestionControl> create(const std::string& name);
+
+    [[nodiscard]] virtual const char* get_name() const = 0;
+
+    /* New transfer, window restarts from initial */
+    virtual void reset();
+
+    /* Feedback, rtt is zero when acknowledged fragment was retransmitted */
+    virtual void on_ack(uint32_t acked, std::chrono::microseconds rtt);
+    void on_loss(uint32_t seq, uint32_t highest_sent);
+    void on_timeout(uint32_t highest_sent);
+
+    [[nodiscard]] virtual uint32_t get_window() const;
+    std::string report() const;
+
+protected:
+    virtual void reduce();              // Loss signalled by negative acknowledgment
+    virtual void collapse();            // Retransmission timeout
+
+    double _cwnd = CC_INITIAL_WINDOW;
+    double _ssthresh = CC_MAX_WINDOW;
+
+    std::chrono::microseconds _last_rtt{0};
+    std::chrono::microseconds _min_rtt{0};
+
+private:
+    uint32_t _recovery_end = 0;         // Losses up to this fragment belong to current epoch
+    uint64_t _losses = 0;
+    uint64_t _timeouts = 0;
+};
+
+/* No congestion window, previous behaviour */
+class NoControl : public CongestionControl {
+public:
+    [[nodiscard]] const char* get_name() const override { return "none"; }
+    [[nodiscard]] uint32_t get_window() const override { return CC_MAX_WINDOW; }
+
+protected:
+    void reduce() override {}
+    void collapse() override {}
+};
+
+/* Loss-driven AIMD */
+class RenoControl : public CongestionControl {
+public:
+    [[nodiscard]] const char* get_name() const override { return "reno"; }
+
+    void on_ack(uint32_t acked, std::chrono::microseconds rtt) override;
+};
+
+/* Delay-driven, backs off when round trip grows before losses appear */
+class DelayControl : public CongestionControl {
+public:
+    [[nodiscard]] const char* get_name() const override { return "delay"; }
+
+    void on_ack(uint32_t acked, std::chrono::microseconds rtt) override;
+};
@@ -0,0 +1,115 @@
+/*
+ * executor.cpp
+ */
+
+#include "executor.h"
+
+Executor::Executor(size_t workers)
+{
+    for (size_t i = 0; i < workers; i++)
+    {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+
+    // Deques exist before any worker may steal from them
+    for (size_t i = 0; i < workers; i++)
+    {
+        _workers[i]->thread = std::thread(&Executor::run, this, i);
+    }
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+        _stopped = true;
+    }
+    _idle_cv.notify_all();
+
+    for (auto& worker : _workers)
+    {
+        if (worker->thread.joinable())
+        {
+            worker->thread.join();
+        }
+    }
+}
+
+void Executor::submit(Task task)
+{
+    Worker& worker = *_workers[_next.fetch_add(1, std::memory_order_relaxed) % _workers.size()];
+
+    // Counted before push, so taking worker never drives counter below zero
+    {
+        std::lock_guard<std::mutex> lock(_idle_mutex);
+        _queued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    _idle_cv.notify_one();
+}
+
+bool Executor::take(size_t index, Task& task)
+{
+    {
+        Worker& own = *_workers[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Oldest task of victim, owner keeps working on its newest
+    for (size_t step = 1; step < _workers.size(); step++)
+    {
+        Worker& victim = *_workers[(index + step) % _workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            _stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void Executor::run(size_t index)
+{
+    while (true)
+    {
+        Task task;
+        if (take(index, task))
+        {
+            _queued.fetch_sub(1, std::memory_order_relaxed);
+            task();
+            _executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(_idle_mutex);
+        _idle_cv.wait(lock, [this]() { return _stopped || _queued.load(std::memory_order_relaxed) > 0; });
+        if (_stopped)
+        {
+            return;
+        }
+    }
+}
+
+std::string Executor::report() const
+{
+    std::ostringstream out;
+    out << "executor workers " << _workers.size()
+        << " tasks " << _executed.load(std::memory_order_relaxed)
+        << " stolen " << _stolen.load(std::memory_order_relaxed);
+
+    return out.str();
+}
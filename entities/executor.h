@@ -0,0 +1,66 @@
+/*
+ * executor.h — Work-Stealing Task Executor
+ *
+ * Fixed set of worker threads, each with own task deque. Tasks submitted from
+ * outside are spread round robin, worker takes its own tasks from back and, once
+ * its deque is empty, steals oldest task from front of another one, so busy
+ * queues are drained by every idle core. Workers sleep while all deques are empty.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#define EXECUTOR_MAX_WORKERS    64
+
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    explicit Executor(size_t workers);
+    ~Executor();        // Finishes running tasks, queued ones are dropped
+
+    void submit(Task task);
+
+    [[nodiscard]] size_t get_workers() const { return _workers.size(); }
+    std::string report() const;
+
+    /* Copy protection */
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void run(size_t index);
+    bool take(size_t index, Task& task);        // Own back first, then steal
+
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<size_t> _next{0};               // Round robin target of submit
+
+    /* Sleeping workers */
+    std::mutex _idle_mutex;
+    std::condition_variable _idle_cv;
+    std::atomic<size_t> _queued{0};
+    bool _stopped = false;
+
+    /* Statistics */
+    std::atomic<uint64_t> _executed{0};
+    std::atomic<uint64_t> _stolen{0};
+};
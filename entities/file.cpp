@@ -4,7 +4,7 @@
 
 #include "file.h"
 
-File::File(const char* name, const unsigned char* file_data, uint32_t file_size)
+File::File(const char* name, const unsigned char* file_data, uint64_t file_size)
 {
     // Name length
     header.name_length = static_cast<uint8_t>(std::strlen(name));
@@ -67,54 +67,136 @@ File::~File()
 
 unsigned char* File::to_buff() const
 {
-    size_t total_size = sizeof(header.name_length) + header.name_length + sizeof(header.file_size) + header.file_size;
+    std::vector<unsigned char> prefix = header_to_buff(header.file_name, header.file_size);
+
+    size_t total_size = prefix.size() + header.file_size;
     auto* buffer = new unsigned char[total_size];
 
-    unsigned char* ptr = buffer;
+    // Header
+    std::memcpy(buffer, prefix.data(), prefix.size());
+
+    // Data
+    std::memcpy(buffer + prefix.size(), data, header.file_size);
+
+    return buffer;
+}
+
+std::vector<unsigned char> File::header_to_buff(const char* name, uint64_t file_size)
+{
+    auto name_length = static_cast<uint8_t>(strnlen(name, FILE_NAME_MAX_LEN));
+
+    std::vector<unsigned char> buffer(sizeof(name_length) + name_length + sizeof(file_size));
+    unsigned char* ptr = buffer.data();
 
     // Name length
-    std::memcpy(ptr, &header.name_length, sizeof(header.name_length));
-    ptr += sizeof(header.name_length);
+    std::memcpy(ptr, &name_length, sizeof(name_length));
+    ptr += sizeof(name_length);
 
     // File name
-    std::memcpy(ptr, header.file_name, header.name_length);
-    ptr += header.name_length;
+    std::memcpy(ptr, name, name_length);
+    ptr += name_length;
 
     // File size
-    uint32_t file_size_net = htonl(header.file_size);
+    uint64_t file_size_net = htobe64(file_size);
     std::memcpy(ptr, &file_size_net, sizeof(file_size_net));
-    ptr += sizeof(file_size_net);
-
-    // Data
-    std::memcpy(ptr, data, header.file_size);
 
     return buffer;
 }
 
 File File::from_buff(const unsigned char* buff)
 {
+    FileHeader header = header_from_buff(buff);
+
+    // Data
+    const unsigned char* ptr = buff + sizeof(header.name_length) + header.name_length + sizeof(header.file_size);
+
+    return File(header.file_name, ptr, header.file_size);
+}
+
+FileHeader File::header_from_buff(const unsigned char* buff)
+{
+    FileHeader header{};
     const unsigned char* ptr = buff;
 
     // Name length
-    uint8_t name_length;
-    std::memcpy(&name_length, ptr, sizeof(name_length));
-    ptr += sizeof(name_length);
+    std::memcpy(&header.name_length, ptr, sizeof(header.name_length));
+    ptr += sizeof(header.name_length);
 
     // File name
-    char file_name[FILE_NAME_MAX_LEN + 1];
-    std::memcpy(file_name, ptr, name_length);
-    file_name[name_length] = '\0';
-    ptr += name_length;
+    size_t name_length = std::min<size_t>(header.name_length, FILE_NAME_MAX_LEN - 1);
+    std::memcpy(header.file_name, ptr, name_length);
+    header.file_name[name_length] = '\0';
+    ptr += header.name_length;
 
     // File size
-    uint32_t size_net;
+    uint64_t size_net;
     std::memcpy(&size_net, ptr, sizeof(size_net));
-    ptr += sizeof(size_net);
-    uint32_t size = ntohl(size_net);
+    header.file_size = be64toh(size_net);
 
-    // Data
-    auto file_data = new unsigned char[size];
-    std::memcpy(file_data, ptr, size);
+    return header;
+}
 
-    return File(file_name, file_data, size);
+std::unique_ptr<MappedFile> MappedFile::open(const std::string& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat info{};
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode))
+    {
+        close(fd);
+        return nullptr;
+    }
+
+    auto size = static_cast<size_t>(info.st_size);
+    unsigned char* data = nullptr;
+
+    // Empty file has nothing to map
+    if (size > 0)
+    {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        // Fragments are read front to back, kernel reads ahead
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<unsigned char*>(mapping);
+    }
+
+    // Mapping stays valid without descriptor
+    close(fd);
+
+    return std::unique_ptr<MappedFile>(new MappedFile(data, size));
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        munmap(data, size);
+        data = nullptr;
+    }
+}
+
+void MappedFile::drop(size_t offset, size_t length)
+{
+    if (data == nullptr || offset >= size)
+    {
+        return;
+    }
+
+    auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t begin = offset / page * page;
+    size_t end = std::min(offset + length, size);
+
+    if (end > begin)
+    {
+        madvise(data + begin, end - begin, MADV_DONTNEED);
+    }
 }
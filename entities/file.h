@@ -7,19 +7,29 @@
 #include <cstdint>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
 #include <netinet/in.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define FILE_NAME_MAX_LEN 255
+#define FILE_RELEASE_CHUNK (4 * 1024 * 1024)    // Sent pages are dropped from memory in steps of this size
 
 struct FileHeader {
     uint8_t name_length;
     char file_name[FILE_NAME_MAX_LEN];
-    uint32_t file_size;
+    uint64_t file_size;         // 64 bits on wire, big endian
 };
 
 class File {
 public:
-    File(const char* name, const unsigned char* file_data, uint32_t file_size);
+    File(const char* name, const unsigned char* file_data, uint64_t file_size);
 
     File(const File& other);
     File(File&& other) noexcept;
@@ -31,11 +41,39 @@ public:
     unsigned char* to_buff() const;
     static File from_buff(const unsigned char* buff);
 
+    /* Serialized header alone, file data follows it on wire */
+    static std::vector<unsigned char> header_to_buff(const char* name, uint64_t file_size);
+    static FileHeader header_from_buff(const unsigned char* buff);
+
     [[nodiscard]] const unsigned char* get_data() const { return data; }
-    [[nodiscard]] uint32_t get_size() const { return header.file_size; }
+    [[nodiscard]] uint64_t get_size() const { return header.file_size; }
     [[nodiscard]] FileHeader get_header() const { return header; };
 
 private:
     FileHeader header;
     unsigned char* data;
 };
+
+/* Read-only mapping of file being sent, fragments are copied straight from page cache */
+class MappedFile {
+public:
+    /* Mapping of whole file, nullptr when it cannot be opened */
+    static std::unique_ptr<MappedFile> open(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    /* Pages in range leave resident memory, next access reads them from page cache again */
+    void drop(size_t offset, size_t length);
+
+    [[nodiscard]] const unsigned char* get_data() const { return data; }
+    [[nodiscard]] size_t get_size() const { return size; }
+
+private:
+    MappedFile(unsigned char* data, size_t size) : data(data), size(size) {}
+
+    unsigned char* data;
+    size_t size;
+};
@@ -0,0 +1,322 @@
+/*
+ * file_writer.cpp
+ */
+
+#include "file_writer.h"
+
+/* Writers alive per target path and retired writers still draining, shared by all peers */
+static std::mutex registry_mutex;
+static std::condition_variable registry_cv;
+static std::unordered_map<std::string, uint64_t> newest_writer;
+static uint64_t writer_generation = 0;
+static size_t retired_writers = 0;
+
+std::unique_ptr<FileWriter> FileWriter::open(const std::string& path, size_t size)
+{
+    // Hidden unique name in same directory, rename onto target stays atomic
+    size_t slash = path.find_last_of('/');
+    std::string temp_path = path.substr(0, slash + 1) + "." + path.substr(slash + 1) + ".XXXXXX";
+
+    int fd = mkostemp(temp_path.data(), O_CLOEXEC);
+    if (fd < 0)
+    {
+        spdlog::error("[FileWriter::open] cannot open file for writing {}: {}", path, strerror(errno));
+        return nullptr;
+    }
+    fchmod(fd, 0644);
+
+    // Blocks reserved up front, placement never fails halfway on full disk
+    if (size > 0 && fallocate(fd, 0, 0, static_cast<off_t>(size)) < 0)
+    {
+        if (errno != EOPNOTSUPP)
+        {
+            spdlog::error("[FileWriter::open] cannot preallocate {} bytes for {}: {}", size, path, strerror(errno));
+            close(fd);
+            unlink(temp_path.c_str());
+            return nullptr;
+        }
+
+        // Filesystem without fallocate, size set at least
+        if (ftruncate(fd, static_cast<off_t>(size)) < 0)
+        {
+            spdlog::error("[FileWriter::open] cannot resize {}: {}", path, strerror(errno));
+            close(fd);
+            unlink(temp_path.c_str());
+            return nullptr;
+        }
+    }
+
+    return std::unique_ptr<FileWriter>(new FileWriter(fd, path, std::move(temp_path), size));
+}
+
+FileWriter::FileWriter(int fd, std::string path, std::string temp_path, size_t size) : _fd(fd), _path(std::move(path)), _temp_path(std::move(temp_path)), _size(size)
+{
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        _generation = ++writer_generation;
+        newest_writer[_path] = _generation;
+    }
+
+    _current.data.reserve(FILE_WRITER_CHUNK);
+    _current.offset = 0;
+
+    _thread = std::thread(&FileWriter::run, this);
+}
+
+FileWriter::~FileWriter()
+{
+    finish();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+void FileWriter::write(const unsigned char* data, size_t length)
+{
+    // Message checksum follows file data
+    length = std::min(length, _size - _received);
+
+    while (length > 0)
+    {
+        size_t space = FILE_WRITER_CHUNK - _current.data.size();
+        size_t part = std::min(space, length);
+
+        _current.data.insert(_current.data.end(), data, data + part);
+        _pending.fetch_add(part, std::memory_order_relaxed);
+        _received += part;
+
+        data += part;
+        length -= part;
+
+        if (_current.data.size() == FILE_WRITER_CHUNK)
+        {
+            submit();
+        }
+    }
+}
+
+void FileWriter::submit()
+{
+    off_t next = _current.offset + static_cast<off_t>(_current.data.size());
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _queue.push_back(std::move(_current));
+
+    // Reuse written chunk, allocate only while queue grows
+    if (!_free.empty())
+    {
+        _current.data = std::move(_free.back());
+        _free.pop_back();
+    }
+    else
+    {
+        _current.data = std::vector<unsigned char>();
+        _current.data.reserve(FILE_WRITER_CHUNK);
+    }
+    _current.offset = next;
+
+    _cv.notify_one();
+}
+
+void FileWriter::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_finishing)
+        {
+            return;
+        }
+    }
+
+    if (!_current.data.empty())
+    {
+        submit();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _finishing = true;
+    _cv.notify_one();
+}
+
+void FileWriter::discard()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _discarded = true;
+    }
+
+    finish();
+}
+
+void FileWriter::retire(std::unique_ptr<FileWriter> writer)
+{
+    if (!writer)
+    {
+        return;
+    }
+
+    writer->finish();
+
+    FileWriter* raw = writer.release();
+    std::unique_lock<std::mutex> lock(raw->_mutex);
+
+    // Queue already drained, joining exited thread does not wait for disk
+    if (raw->_done)
+    {
+        lock.unlock();
+        delete raw;
+        return;
+    }
+
+    raw->_thread.detach();
+    raw->_retired = true;
+
+    std::lock_guard<std::mutex> registry_lock(registry_mutex);
+    retired_writers++;
+}
+
+void FileWriter::supersede(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    newest_writer.erase(path);
+}
+
+void FileWriter::wait_retired()
+{
+    std::unique_lock<std::mutex> lock(registry_mutex);
+    registry_cv.wait(lock, []() { return retired_writers == 0; });
+}
+
+void FileWriter::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    while (true)
+    {
+        _cv.wait(lock, [this]() { return !_queue.empty() || _finishing; });
+
+        if (_queue.empty())
+        {
+            break;
+        }
+
+        chunk job = std::move(_queue.front());
+        _queue.pop_front();
+
+        lock.unlock();
+        place(job);
+        lock.lock();
+
+        _pending.fetch_sub(job.data.size(), std::memory_order_relaxed);
+
+        if (_free.size() < FILE_WRITER_FREE_CHUNKS)
+        {
+            job.data.clear();
+            _free.push_back(std::move(job.data));
+        }
+    }
+
+    lock.unlock();
+    close_file();
+
+    lock.lock();
+    _done = true;
+    bool retired = _retired;
+    lock.unlock();
+
+    // Nobody joins detached thread, it frees writer itself
+    if (retired)
+    {
+        delete this;
+
+        std::lock_guard<std::mutex> registry_lock(registry_mutex);
+        retired_writers--;
+        registry_cv.notify_all();
+    }
+}
+
+void FileWriter::place(const chunk& job)
+{
+    if (_failed)
+    {
+        return;
+    }
+
+    const unsigned char* data = job.data.data();
+    size_t length = job.data.size();
+    off_t offset = job.offset;
+
+    while (length > 0)
+    {
+        ssize_t written = pwrite(_fd, data, length, offset);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            spdlog::error("[FileWriter::place] cannot write {} at offset {}: {}", _path, static_cast<int64_t>(offset), strerror(errno));
+            _failed = true;
+            return;
+        }
+
+        data += written;
+        length -= static_cast<size_t>(written);
+        offset += written;
+    }
+}
+
+void FileWriter::close_file()
+{
+    close(_fd);
+    _fd = -1;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    // Later transfer of same name started meanwhile, its file replaces target
+    auto newest = newest_writer.find(_path);
+    bool superseded = newest == newest_writer.end() || newest->second != _generation;
+    if (!superseded)
+    {
+        newest_writer.erase(newest);
+    }
+
+    // Received data is corrupt, target is left as it was
+    if (_discarded)
+    {
+        unlink(_temp_path.c_str());
+        spdlog::error("[FileWriter::close_file] file {} discarded, checksum mismatch", _path);
+        return;
+    }
+
+    // Transfer ended early, target is left as it was
+    if (_failed || _received != _size)
+    {
+        unlink(_temp_path.c_str());
+        spdlog::error("[FileWriter::close_file] file {} incomplete, written {} of {} bytes", _path, _received, _size);
+        std::cout << "error file writing " << _path << std::endl;
+        return;
+    }
+
+    if (superseded)
+    {
+        unlink(_temp_path.c_str());
+        spdlog::info("[FileWriter::close_file] file {} superseded by newer transfer", _path);
+        return;
+    }
+
+    if (rename(_temp_path.c_str(), _path.c_str()) < 0)
+    {
+        spdlog::error("[FileWriter::close_file] cannot move {} to {}: {}", _temp_path, _path, strerror(errno));
+        unlink(_temp_path.c_str());
+        std::cout << "error file writing " << _path << std::endl;
+        return;
+    }
+
+    spdlog::info("[FileWriter::close_file] file {} written, size {}", _path, _size);
+    std::cout << "received file " << _path << std::endl;
+}
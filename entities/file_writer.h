@@ -0,0 +1,106 @@
+/*
+ * file_writer.h — Asynchronous Direct-Placement File Writer
+ *
+ * Received file is written to disk while it arrives instead of being assembled
+ * in memory. Target is preallocated to announced size, in-order data is gathered
+ * into chunks and each chunk is placed at its offset with pwrite by writer thread,
+ * so receiving thread only copies into memory and never waits for disk.
+ * Bytes queued and not yet written are reported, receiver counts them against
+ * advertised window, so backlog stays bounded when disk is slower than network.
+ * Data goes to hidden temporary file next to target, which replaces target only
+ * once complete, so writer still draining previous file of same name never
+ * writes into new one and interrupted transfer leaves no partial file behind.
+ */
+
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/stat.h>
+#include <spdlog/spdlog.h>
+
+#define FILE_WRITER_CHUNK       (1024 * 1024)   // Bytes gathered before one pwrite
+#define FILE_WRITER_FREE_CHUNKS 8               // Written chunks kept for reuse
+
+class FileWriter {
+public:
+    /* Creates and preallocates temporary file for target, nullptr when it cannot be created */
+    static std::unique_ptr<FileWriter> open(const std::string& path, size_t size);
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /* Waits for queued chunks, closes file if finish was not called */
+    ~FileWriter();
+
+    /* Appends next in-order bytes, copies only, bytes past announced size are ignored */
+    void write(const unsigned char* data, size_t length);
+
+    /* Last bytes appended, writer closes file once queue drains */
+    void finish();
+
+    /* Last bytes appended but message failed verification, file is dropped instead of replacing target */
+    void discard();
+
+    /* Finishes and hands writer to its own thread, which frees it after last write, caller never waits for disk */
+    static void retire(std::unique_ptr<FileWriter> writer);
+
+    /* Blocks until every retired writer has closed its file, called before process exits */
+    static void wait_retired();
+
+    /* Target is written elsewhere, writers still draining into it discard their data */
+    static void supersede(const std::string& path);
+
+    [[nodiscard]] size_t pending() const { return _pending.load(std::memory_order_relaxed); }
+    [[nodiscard]] size_t get_received() const { return _received; }
+    [[nodiscard]] const std::string& get_path() const { return _path; }
+
+private:
+    FileWriter(int fd, std::string path, std::string temp_path, size_t size);
+
+    struct chunk {
+        std::vector<unsigned char> data;
+        off_t offset;
+    };
+
+    void submit();
+    void run();
+    void place(const chunk& job);
+    void close_file();
+
+    int _fd;
+    std::string _path;
+    std::string _temp_path;         // Renamed to path once complete
+    uint64_t _generation;           // Newest writer of same path replaces target, older ones are dropped
+    size_t _size;                   // Announced by sender
+
+    chunk _current;                 // Being filled by receiving thread
+    size_t _received = 0;           // Bytes appended so far
+
+    std::deque<chunk> _queue;
+    std::vector<std::vector<unsigned char>> _free;
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _finishing = false;
+    bool _failed = false;           // Writer thread only
+    bool _discarded = false;        // Set before finishing, read by writer thread after it
+    bool _done = false;             // File closed, thread about to exit
+    bool _retired = false;          // Thread detached, frees writer when done
+
+    std::atomic<size_t> _pending{0};
+    std::thread _thread;
+};
@@ -0,0 +1,788 @@
+/*
+ * host.cpp
+ */
+
+#include "host.h"
+
+Host::Host()
+{
+    _shards.push_back(std::make_unique<Shard>());
+
+    if (!configure_socket(_shards[0]->socket, false))
+    {
+        exit(EXIT_FAILURE);
+    }
+
+    // Granted size bounds advertised windows
+    socklen_t opt_len = sizeof(_socket_rcvbuf);
+    if (getsockopt(_shards[0]->socket.get_socket(), SOL_SOCKET, SO_RCVBUF, &_socket_rcvbuf, &opt_len) < 0)
+    {
+        perror("getsockopt SO_RCVBUF");
+        _socket_rcvbuf = 3000000;
+    }
+
+    _peers.reserve(HOST_MAX_PEERS);
+
+    // Commands go to first peer until destination selects another
+    _nodes.push_back(std::make_unique<Node>(*this, _shards[0]->socket, _shards[0]->reactor));
+    _selected = _nodes.back().get();
+}
+
+Host::~Host()
+{
+    stop_receiving();
+    _executor.reset();
+    _transmitter.reset();
+
+    // Loops and workers are stopped, no handler can reach peers
+    std::unique_lock<std::shared_mutex> lock(_peers_mutex);
+    _peers.clear();
+    _nodes.clear();
+    _closing.clear();
+
+    // Files already acknowledged to senders reach disk before exit
+    FileWriter::wait_retired();
+}
+
+bool Host::configure_socket(Socket& socket, bool reuse_port)
+{
+    if (socket.get_socket() < 0)
+    {
+        return false;
+    }
+
+    if (socket.set_non_blocking() < 0)
+    {
+        return false;
+    }
+
+    // Every shard binds same port, kernel spreads peers by 4-tuple hash
+    int reuse = 1;
+    if (reuse_port && setsockopt(socket.get_socket(), SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+    {
+        perror("setsockopt SO_REUSEPORT");
+        return false;
+    }
+
+    // Datagrams never fragmented by IP, path probing finds size that passes
+    if (!socket.set_dont_fragment())
+    {
+        perror("setsockopt IP_MTU_DISCOVER");
+    }
+
+    int buff_size = 3000000;
+    if (setsockopt(socket.get_socket(), SOL_SOCKET, SO_RCVBUF, &buff_size, sizeof(buff_size)) < 0)
+    {
+        perror("setsockopt SO_RCVBUF");
+    }
+    if (setsockopt(socket.get_socket(), SOL_SOCKET, SO_SNDBUF, &buff_size, sizeof(buff_size)) < 0)
+    {
+        perror("setsockopt SO_SNDBUF");
+    }
+
+    return true;
+}
+
+void Host::set_port(uint16_t port)
+{
+    _port = port;
+    sockaddr_in local_addr{};
+    local_addr.sin_family = AF_INET;
+    local_addr.sin_port = htons(_port);
+    local_addr.sin_addr.s_addr = INADDR_ANY;
+
+    for (auto& shard : _shards)
+    {
+        if (bind(shard->socket.get_socket(), reinterpret_cast<struct sockaddr*>(&local_addr), sizeof(local_addr)) < 0)
+        {
+            perror("bind");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    {
+        std::shared_lock<std::shared_mutex> lock(_peers_mutex);
+        for (auto& node : _nodes)
+        {
+            node->set_port(port);
+        }
+    }
+
+    // Bound sockets are listening for every peer
+    start_receiving();
+}
+
+void Host::set_shards(size_t count)
+{
+    if (_port != 0 || _receive_running)
+    {
+        std::cout << "shards must be set before port" << std::endl;
+        return;
+    }
+
+    if (_shards[0]->socket.uring_enabled())
+    {
+        std::cout << "shards must be set before io_uring" << std::endl;
+        return;
+    }
+
+    // First socket joins reuse group too, extra ones are replaced
+    int reuse = count > 1 ? 1 : 0;
+    if (setsockopt(_shards[0]->socket.get_socket(), SOL_SOCKET, SO_REUSEPORT, &reuse, sizeof(reuse)) < 0)
+    {
+        perror("setsockopt SO_REUSEPORT");
+        std::cout << "port sharding not supported" << std::endl;
+        return;
+    }
+
+    _shards.resize(1);
+    while (_shards.size() < count)
+    {
+        auto shard = std::make_unique<Shard>();
+        if (!configure_socket(shard->socket, true))
+        {
+            std::cout << "cannot open shard socket" << std::endl;
+            break;
+        }
+
+        if (_offload)
+        {
+            shard->socket.set_gro(true);
+            shard->gro_buff.resize(SOCKET_GRO_BUFF_LEN);
+        }
+        _shards.push_back(std::move(shard));
+    }
+
+    spdlog::info("[Host::set_shards] set {} receive shards", _shards.size());
+}
+
+void Host::set_workers(size_t count)
+{
+    if (_port != 0 || _receive_running)
+    {
+        std::cout << "workers must be set before port" << std::endl;
+        return;
+    }
+
+    _executor = count > 0 ? std::make_unique<Executor>(count) : nullptr;
+    spdlog::info("[Host::set_workers] set {} protocol workers", count);
+}
+
+void Host::set_transmitter(bool enabled)
+{
+    if (_port != 0 || _receive_running)
+    {
+        std::cout << "transmit stage must be set before port" << std::endl;
+        return;
+    }
+
+    if (enabled && _offload)
+    {
+        std::cout << "transmit stage cannot be combined with segmentation offload" << std::endl;
+        return;
+    }
+
+    // First shard socket stays across shard changes, others share its port
+    _transmitter = enabled ? std::make_unique<Transmitter>(_shards[0]->socket) : nullptr;
+    spdlog::info("[Host::set_transmitter] set transmit stage {}", enabled ? "on" : "off");
+}
+
+void Host::set_batch_size(size_t size)
+{
+    _batch_size = size;
+    spdlog::info("[Host::set_batch_size] set batch size {}", size);
+}
+
+void Host::set_offload(bool enabled)
+{
+    if (enabled && _shards[0]->socket.uring_enabled())
+    {
+        std::cout << "segmentation offload cannot be combined with io_uring" << std::endl;
+        return;
+    }
+
+    if (enabled && _transmitter)
+    {
+        std::cout << "segmentation offload cannot be combined with transmit stage" << std::endl;
+        return;
+    }
+
+    if (enabled && !_shards[0]->socket.gso_supported())
+    {
+        std::cout << "segmentation offload not supported" << std::endl;
+        return;
+    }
+
+    for (auto& shard : _shards)
+    {
+        if (!shard->socket.set_gro(enabled) && enabled)
+        {
+            // Still useful for sending, receiver keeps per-datagram reads
+            spdlog::warn("[Host::set_offload] receive offload not supported");
+        }
+
+        if (enabled && shard->gro_buff.empty())
+        {
+            shard->gro_buff.resize(SOCKET_GRO_BUFF_LEN);
+        }
+    }
+
+    _offload = enabled;
+    spdlog::info("[Host::set_offload] set segmentation offload {}", enabled ? "on" : "off");
+}
+
+void Host::set_uring(bool enabled)
+{
+    if (enabled && _offload)
+    {
+        std::cout << "io_uring cannot be combined with segmentation offload" << std::endl;
+        return;
+    }
+
+    for (auto& shard_ptr : _shards)
+    {
+        Shard& shard = *shard_ptr;
+
+        // Ring is only touched by its loop thread once receiving started
+        auto apply = [this, &shard, enabled]() {
+            unwatch_socket(shard);
+
+            if (!shard.socket.set_uring(enabled))
+            {
+                spdlog::warn("[Host::set_uring] io_uring not supported, staying on epoll");
+                std::cout << "io_uring not supported, using epoll" << std::endl;
+            }
+            else
+            {
+                spdlog::info("[Host::set_uring] set io_uring backend {}", enabled ? "on" : "off");
+            }
+
+            if (_receive_running)
+            {
+                watch_socket(shard);
+            }
+        };
+
+        if (_receive_running)
+        {
+            shard.reactor.post(apply);
+        }
+        else
+        {
+            apply();
+        }
+    }
+}
+
+void Host::set_accepting(bool enabled)
+{
+    _accepting = enabled;
+    spdlog::info("[Host::set_accepting] accepting new peers {}", enabled ? "on" : "off");
+}
+
+uint64_t Host::peer_key(const sockaddr_in& addr)
+{
+    return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+Node* Host::select_peer(in_addr ip, uint16_t port)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr = ip;
+
+    std::unique_lock<std::shared_mutex> lock(_peers_mutex);
+
+    Node* node = nullptr;
+    auto it = _peers.find(peer_key(addr));
+    if (it != _peers.end())
+    {
+        node = it->second;
+    }
+    else if (_selected.load()->get_pcb().dest_port == 0)
+    {
+        // Selected peer has no destination yet, it takes this one
+        node = _selected.load();
+        node->set_dest(ip, port);
+        _peers[peer_key(addr)] = node;
+    }
+    else
+    {
+        // Receiving shard is not known ahead, first one serves peer until replies arrive elsewhere
+        node = add_peer(*_shards[0], addr, _selected.load());
+        if (node == nullptr)
+        {
+            std::cout << "connection table full" << std::endl;
+            return _selected.load();
+        }
+    }
+
+    // Closed peer was kept only for commands
+    Node* previous = _selected.exchange(node);
+    if (previous != node && (previous->get_pcb().phase == TCU_PHASE_HOLDOFF || previous->get_pcb().phase == TCU_PHASE_CLOSED))
+    {
+        unlink_peer(previous);
+    }
+
+    spdlog::info("[Host::select_peer] selected peer {}:{}, {} peers", inet_ntoa(ip), port, _peers.size());
+    return node;
+}
+
+void Host::release_peer(Node* node)
+{
+    std::unique_lock<std::shared_mutex> lock(_peers_mutex);
+
+    // Commands still target selected peer, it is released once another one is selected
+    if (node == _selected.load())
+    {
+        return;
+    }
+
+    unlink_peer(node);
+}
+
+void Host::unlink_peer(Node* node)
+{
+    auto owned = std::find_if(_nodes.begin(), _nodes.end(), [node](const std::unique_ptr<Node>& entry) { return entry.get() == node; });
+    if (owned == _nodes.end())
+    {
+        return;
+    }
+
+    uint64_t key = peer_key(node->get_pcb().dest_addr);
+    auto it = _peers.find(key);
+    if (it != _peers.end() && it->second == node)
+    {
+        _peers.erase(it);
+    }
+
+    // Shard tables are touched only by their own loops, each drops its route there
+    node->mark_released();
+    auto routed = std::make_shared<std::atomic<size_t>>(_shards.size());
+    for (auto& shard_ptr : _shards)
+    {
+        Shard& shard = *shard_ptr;
+        auto drop = [&shard, key, node, routed]() {
+            auto entry = shard.peers.find(key);
+            if (entry != shard.peers.end() && entry->second == node)
+            {
+                shard.peers.erase(entry);
+            }
+            routed->fetch_sub(1, std::memory_order_acq_rel);
+        };
+
+        if (_receive_running)
+        {
+            shard.reactor.post(drop);
+        }
+        else
+        {
+            drop();
+        }
+    }
+
+    spdlog::info("[Host::unlink_peer] released peer {}:{}, {} peers", inet_ntoa(node->get_pcb().dest_ip), node->get_pcb().dest_port, _peers.size());
+
+    _closing.push_back({std::move(*owned), std::chrono::steady_clock::now(), routed});
+    _nodes.erase(owned);
+
+    sweep_peers();
+}
+
+void Host::sweep_peers()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // No shard routes to peer and its last datagrams are processed, timer and handlers are long done
+    auto freed = std::remove_if(_closing.begin(), _closing.end(), [now](const closing_peer& peer) {
+        return now - peer.since >= std::chrono::seconds(HOST_PEER_LINGER)
+            && peer.routed->load(std::memory_order_acquire) == 0
+            && peer.node->inbox_idle();
+    });
+    _closing.erase(freed, _closing.end());
+}
+
+Node* Host::add_peer(Shard& shard, const sockaddr_in& addr, Node* settings)
+{
+    sweep_peers();
+
+    if (_peers.size() >= HOST_MAX_PEERS)
+    {
+        return nullptr;
+    }
+
+    _nodes.push_back(std::make_unique<Node>(*this, shard.socket, shard.reactor));
+    Node* node = _nodes.back().get();
+
+    node->copy_settings(*settings);
+    node->set_dest(addr.sin_addr, ntohs(addr.sin_port));
+    _peers[peer_key(addr)] = node;
+
+    return node;
+}
+
+Node* Host::lookup_peer(Shard& shard, const unsigned char* buff, size_t length, const sockaddr_in& src_addr)
+{
+    uint64_t key = peer_key(src_addr);
+
+    std::unique_lock<std::shared_mutex> lock(_peers_mutex);
+
+    Node* node = nullptr;
+    auto it = _peers.find(key);
+    if (it != _peers.end())
+    {
+        node = it->second;
+
+        // Peer opened by command started on first shard, it follows its replies to this one
+        if (_shards.size() > 1 && !node->homed_on(shard.reactor))
+        {
+            node->move_to(shard.socket, shard.reactor);
+        }
+    }
+    else
+    {
+        // Only connection request opens new entry, anything else from unknown address is dropped
+        tcu_packet_view packet;
+        if (!_accepting || !tcu_packet_view::parse(buff, length, packet) || packet.header.flags != TCU_HDR_FLAG_SYN)
+        {
+            spdlog::warn("[Host::lookup_peer] dropped datagram from unknown peer {}:{}", inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port));
+            return nullptr;
+        }
+
+        node = add_peer(shard, src_addr, _selected.load());
+        if (node == nullptr)
+        {
+            spdlog::warn("[Host::lookup_peer] connection table full, refused {}:{}", inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port));
+            return nullptr;
+        }
+
+        spdlog::info("[Host::lookup_peer] accepted peer {}:{}, {} peers", inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port), _peers.size());
+    }
+
+    // Kernel keeps steering this peer here, later lookups stay in shard
+    shard.peers[key] = node;
+    return node;
+}
+
+void Host::dispatch(Shard& shard, const unsigned char* buff, size_t length, const sockaddr_in& src_addr)
+{
+    Node* node = nullptr;
+
+    // Released peer is still routed until its shard drops it, new connection from address gets new peer
+    auto it = shard.peers.find(peer_key(src_addr));
+    if (it != shard.peers.end() && !it->second->is_released())
+    {
+        node = it->second;
+    }
+    else
+    {
+        node = lookup_peer(shard, buff, length, src_addr);
+        if (node == nullptr)
+        {
+            return;
+        }
+    }
+
+    shard.packets.fetch_add(1, std::memory_order_relaxed);
+
+    if (_executor)
+    {
+        node->enqueue(buff, length, *_executor);
+    }
+    else
+    {
+        node->fsm_process(buff, length);
+    }
+}
+
+size_t Host::get_receive_share() const
+{
+    // Kernel doubles SO_RCVBUF for bookkeeping, half of each shard buffer holds datagrams
+    size_t total = static_cast<size_t>(_socket_rcvbuf / 2) * _shards.size();
+    return total / std::max<size_t>(_connections.load(std::memory_order_relaxed), 1);
+}
+
+void Host::count_connection(bool opened)
+{
+    if (opened)
+    {
+        _connections.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        _connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+size_t Host::peer_count() const
+{
+    std::shared_lock<std::shared_mutex> lock(_peers_mutex);
+    return _peers.size();
+}
+
+std::string Host::report() const
+{
+    std::ostringstream out;
+    out << "peers " << peer_count()
+        << " connections " << _connections.load(std::memory_order_relaxed)
+        << " accepting " << (_accepting ? "on" : "off")
+        << " shards " << _shards.size();
+
+    // Per shard datagrams, skew shows uneven kernel hashing
+    if (_shards.size() > 1)
+    {
+        out << " (";
+        for (size_t i = 0; i < _shards.size(); i++)
+        {
+            out << (i > 0 ? " " : "") << _shards[i]->packets.load(std::memory_order_relaxed);
+        }
+        out << " packets)";
+    }
+
+    if (_executor)
+    {
+        std::shared_lock<std::shared_mutex> lock(_peers_mutex);
+
+        size_t inbox_peak = 0;
+        for (auto& node : _nodes)
+        {
+            inbox_peak = std::max(inbox_peak, node->get_inbox_peak());
+        }
+        out << "\n" << _executor->report() << " inbox peak " << inbox_peak;
+    }
+
+    if (_transmitter)
+    {
+        out << "\n" << _transmitter->report();
+    }
+
+    return out.str();
+}
+
+std::string Host::report_peers() const
+{
+    static const char* phases[] = {"dead", "holdoff", "initialize", "connect", "network", "disconnect", "closed"};
+
+    std::ostringstream out;
+    {
+        std::shared_lock<std::shared_mutex> lock(_peers_mutex);
+        for (auto& node : _nodes)
+        {
+            tcu_pcb& pcb = node->get_pcb();
+            if (pcb.dest_port == 0)
+            {
+                continue;
+            }
+
+            out << (node.get() == _selected.load() ? "* " : "  ")
+                << inet_ntoa(pcb.dest_ip) << ":" << pcb.dest_port
+                << " " << (pcb.phase <= TCU_PHASE_CLOSED ? phases[pcb.phase] : "unknown") << "\n";
+        }
+    }
+
+    // Summary takes table lock itself
+    out << report();
+
+    return out.str();
+}
+
+void Host::start_receiving()
+{
+    if (!_receive_running)
+    {
+        _receive_running = true;
+
+        for (auto& shard_ptr : _shards)
+        {
+            Shard& shard = *shard_ptr;
+
+            watch_socket(shard);
+            shard.thread = std::thread([&shard]() { shard.reactor.run(); });
+        }
+    }
+}
+
+void Host::stop_receiving()
+{
+    _receive_running = false;
+
+    // Loops are woken through eventfd, so shutdown does not wait for timeout
+    for (auto& shard : _shards)
+    {
+        shard->reactor.stop();
+    }
+
+    for (auto& shard : _shards)
+    {
+        if (shard->thread.joinable())
+        {
+            shard->thread.join();
+        }
+    }
+
+    // Queued datagrams leave before socket closes, descriptor may be reused afterwards
+    if (_transmitter)
+    {
+        _transmitter->stop();
+    }
+
+    for (auto& shard : _shards)
+    {
+        shard->socket.close_socket();
+    }
+}
+
+void Host::watch_socket(Shard& shard)
+{
+    // Readiness wakes loop, no polling interval
+    if (shard.socket.uring_enabled())
+    {
+        shard.reactor.add(shard.socket.get_uring(), EPOLLIN, [this, &shard](uint32_t) { receive_uring(shard); });
+    }
+    else
+    {
+        shard.reactor.add(shard.socket.get_socket(), EPOLLIN, [this, &shard](uint32_t) { receive_packet(shard); });
+    }
+}
+
+void Host::unwatch_socket(Shard& shard)
+{
+    shard.reactor.remove(shard.socket.get_socket());
+    if (shard.socket.uring_enabled())
+    {
+        shard.reactor.remove(shard.socket.get_uring());
+    }
+}
+
+void Host::receive_packet(Shard& shard)
+{
+    if (_offload)
+    {
+        receive_segmented(shard);
+        return;
+    }
+
+    if (_batch_size > 1)
+    {
+        receive_batch(shard);
+        return;
+    }
+
+    unsigned char temp_buff[SOCKET_RECV_BUFF_LEN];
+
+    // Drain socket until it would block, epoll wakes loop again on new data
+    while (true)
+    {
+        struct sockaddr_in src_addr{};
+        socklen_t src_addr_len = sizeof(src_addr);
+
+        ssize_t num_bytes = recvfrom(shard.socket.get_socket(), temp_buff, sizeof(temp_buff), MSG_DONTWAIT, (struct sockaddr*)&src_addr, &src_addr_len);
+
+        if (num_bytes < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                perror("recvfrom");
+            }
+            break;
+        }
+
+        spdlog::info("[Host::receive_packet] received {} bytes from {}:{}", num_bytes, inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port));
+
+        uint64_t allocs_before = thread_alloc_count();
+
+        dispatch(shard, temp_buff, static_cast<size_t>(num_bytes), src_addr);
+
+        Stats& stats = Stats::get_instance();
+        stats.rx_packets.fetch_add(1, std::memory_order_relaxed);
+        stats.rx_syscalls.fetch_add(1, std::memory_order_relaxed);
+        stats.rx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+    }
+}
+
+void Host::receive_batch(Shard& shard)
+{
+    // Drain socket into pre-allocated buffers, then process whole batch
+    while (true)
+    {
+        int count = shard.socket.receive_batch(shard.rx_batch, _batch_size);
+        if (count <= 0)
+        {
+            break;
+        }
+
+        spdlog::info("[Host::receive_batch] received batch of {} datagrams", count);
+
+        uint64_t allocs_before = thread_alloc_count();
+
+        for (int i = 0; i < count; i++)
+        {
+            dispatch(shard, shard.rx_batch.data(i), shard.rx_batch.length(i), shard.rx_batch.addr(i));
+        }
+
+        Stats& stats = Stats::get_instance();
+        stats.rx_packets.fetch_add(count, std::memory_order_relaxed);
+        stats.rx_syscalls.fetch_add(1, std::memory_order_relaxed);
+        stats.rx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+
+        if (static_cast<size_t>(count) < _batch_size)
+        {
+            break;
+        }
+    }
+}
+
+void Host::receive_segmented(Shard& shard)
+{
+    // Drain coalesced datagrams, then split them back into TCU packets in place
+    while (true)
+    {
+        sockaddr_in src_addr{};
+        uint16_t segment_size = 0;
+
+        ssize_t num_bytes = shard.socket.receive_segmented(shard.gro_buff.data(), shard.gro_buff.size(), src_addr, segment_size);
+        if (num_bytes <= 0)
+        {
+            break;
+        }
+
+        size_t length = static_cast<size_t>(num_bytes);
+        size_t step = segment_size > 0 ? segment_size : length;
+
+        spdlog::info("[Host::receive_segmented] received {} bytes in {} segments from {}:{}", length, (length + step - 1) / step, inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port));
+
+        uint64_t allocs_before = thread_alloc_count();
+
+        // Coalesced segments always share one source
+        size_t segments = 0;
+        for (size_t offset = 0; offset < length; offset += step)
+        {
+            dispatch(shard, shard.gro_buff.data() + offset, std::min(step, length - offset), src_addr);
+            segments++;
+        }
+
+        Stats& stats = Stats::get_instance();
+        stats.rx_packets.fetch_add(segments, std::memory_order_relaxed);
+        stats.rx_syscalls.fetch_add(1, std::memory_order_relaxed);
+        stats.rx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+    }
+}
+
+void Host::receive_uring(Shard& shard)
+{
+    // Completions are read from shared ring, no syscall per datagram
+    uint64_t allocs_before = thread_alloc_count();
+
+    size_t count = shard.socket.receive_uring([this, &shard](const unsigned char* data, size_t length, const sockaddr_in& src_addr) {
+        spdlog::info("[Host::receive_uring] received {} bytes from {}:{}", length, inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port));
+        dispatch(shard, data, length, src_addr);
+    });
+
+    if (count > 0)
+    {
+        Stats& stats = Stats::get_instance();
+        stats.rx_packets.fetch_add(count, std::memory_order_relaxed);
+        stats.rx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,171 @@
+/*
+ * host.h — Shared Socket and Connection Table
+ *
+ * One UDP port and its event loops serve every peer. Each remote address and
+ * port owns separate Node (protocol control block, send and receive state,
+ * timers), incoming datagrams are routed to it by hash lookup on source address.
+ * Connection request from unknown address creates new peer, which takes settings
+ * of selected one. Socket level options (port, batching, offload, io_uring) are
+ * set here, protocol options stay per peer. Peer whose connection closes leaves
+ * table, so same address can connect again as new peer, and is freed once shards
+ * and workers have let go of it.
+ *
+ * Sharded mode opens one SO_REUSEPORT socket per worker thread on same port.
+ * Kernel hashes every 4-tuple to one socket, so each worker owns disjoint set of
+ * peers and finds them in its own table without locking. Shared table is only
+ * consulted on first datagram of peer seen by worker. Peers opened by commands
+ * start on first shard and move socket and timers to shard their replies reach.
+ *
+ * With executor workers, receiving threads only pull datagrams and queue them
+ * on their peer, validation, reassembly and delivery run on worker pool.
+ * With transmit stage, every thread queues outgoing datagrams and one thread
+ * sends them, so socket is written from single place in batches.
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#include "node.h"
+#include "socket.h"
+#include "reactor.h"
+#include "executor.h"
+#include "transmitter.h"
+#include "../tools/stats.h"
+
+#define HOST_MAX_PEERS          1024    // Connection table entries, requests past it are ignored
+#define HOST_MAX_SHARDS         64      // Receive workers with own socket and event loop
+#define HOST_PEER_LINGER        1       // Seconds released peer is kept before it is freed
+
+class Host {
+public:
+    Host();
+    ~Host();
+
+    /* Socket level setters */
+    void set_port(uint16_t port);
+    void set_shards(size_t count);          // Before port is set, 1 disables sharding
+    void set_workers(size_t count);         // Before port is set, 0 processes on receiving thread
+    void set_transmitter(bool enabled);     // Before port is set, off sends on calling thread
+    void set_batch_size(size_t size);
+    void set_offload(bool enabled);
+    void set_uring(bool enabled);
+    void set_accepting(bool enabled);
+
+    /* Peer selected for commands, created on first use of address */
+    Node* select_peer(in_addr ip, uint16_t port);
+    [[nodiscard]] Node* get_selected() const { return _selected.load(); }
+
+    /* Closed peer leaves table, freed once no loop or worker can reach it, selected one stays */
+    void release_peer(Node* node);
+
+    /* Shared with peers */
+    [[nodiscard]] uint16_t get_port() const { return _port; }
+    [[nodiscard]] size_t get_batch_size() const { return _batch_size; }
+    [[nodiscard]] bool offload_enabled() const { return _offload; }
+    [[nodiscard]] Transmitter* get_transmitter() const { return _transmitter.get(); }
+    void disable_offload() { _offload = false; }
+
+    /* Kernel receive buffers split among open connections */
+    [[nodiscard]] size_t get_receive_share() const;
+    void count_connection(bool opened);
+
+    [[nodiscard]] size_t peer_count() const;
+    std::string report() const;
+    std::string report_peers() const;
+
+    /* Thread methods */
+    void start_receiving();
+    void stop_receiving();
+
+    /* Copy protection */
+    Host(const Host&) = delete;
+    Host& operator=(const Host&) = delete;
+
+private:
+    /* Receive path of one socket, touched only by its own thread once running */
+    struct Shard {
+        Shard() : socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) {}
+
+        Socket socket;
+        Reactor reactor;
+
+        ReceiveBatch rx_batch{SOCKET_MAX_BATCH, SOCKET_RECV_BUFF_LEN};
+        std::vector<unsigned char> gro_buff;
+
+        std::unordered_map<uint64_t, Node*> peers;      // Peers kernel steers here, no lock
+        std::atomic<uint64_t> packets{0};               // Written by shard thread only
+
+        std::thread thread;
+    };
+
+    static uint64_t peer_key(const sockaddr_in& addr);
+
+    /* Socket options shared by every shard */
+    bool configure_socket(Socket& socket, bool reuse_port);
+
+    /* Routes datagram to owning peer, connection request may create one */
+    void dispatch(Shard& shard, const unsigned char* buff, size_t length, const sockaddr_in& src_addr);
+    Node* lookup_peer(Shard& shard, const unsigned char* buff, size_t length, const sockaddr_in& src_addr);
+    Node* add_peer(Shard& shard, const sockaddr_in& addr, Node* settings);     // Table lock held
+    void unlink_peer(Node* node);       // Table lock held
+    void sweep_peers();                 // Table lock held
+
+    /* Shards, first one serves peers created by commands until their replies arrive */
+    std::vector<std::unique_ptr<Shard>> _shards;
+    uint16_t _port = 0;
+    int _socket_rcvbuf = 0;
+
+    /* Batched I/O params */
+    size_t _batch_size = 1;         // 1 means per-packet syscalls
+
+    std::atomic<bool> _offload{false};      // UDP GSO on send, GRO on receive
+
+    /* Event loop, socket readiness and timers */
+    void watch_socket(Shard& shard);    // Registers socket or io_uring completions
+    void unwatch_socket(Shard& shard);
+
+    /* Receiving thread params */
+    void receive_packet(Shard& shard);          // Function to receive packet
+    void receive_batch(Shard& shard);           // Function to drain socket with batched syscalls
+    void receive_segmented(Shard& shard);       // Function to drain socket with UDP GRO
+    void receive_uring(Shard& shard);           // Function to reap io_uring receive completions
+    std::atomic<bool> _receive_running{false};
+
+    /* Protocol processing off receiving threads, nullptr keeps it inline */
+    std::unique_ptr<Executor> _executor;
+
+    /* Sending thread fed by per-thread rings, nullptr sends on calling thread */
+    std::unique_ptr<Transmitter> _transmitter;
+
+    /* Released peer, shards drop their route to it before it is freed */
+    struct closing_peer {
+        std::unique_ptr<Node> node;
+        std::chrono::steady_clock::time_point since;
+        std::shared_ptr<std::atomic<size_t>> routed;    // Shards not yet past release
+    };
+
+    /* Connection table */
+    std::vector<std::unique_ptr<Node>> _nodes;          // Owned peers, closed ones move to closing
+    std::vector<closing_peer> _closing;
+    std::unordered_map<uint64_t, Node*> _peers;         // Source address and port to peer
+    mutable std::shared_mutex _peers_mutex;
+    std::atomic<Node*> _selected{nullptr};              // Target of commands, template for accepted peers
+    std::atomic<bool> _accepting{true};
+    std::atomic<size_t> _connections{0};                // Peers between connect and disconnect
+};
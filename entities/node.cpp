@@ -3,30 +3,12 @@
  */
 
 #include "node.h"
+#include "host.h"
 
-Node::Node() : _socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP), _receive_running(false), _keep_alive_running(false)
+Node::Node(Host& host, Socket& socket, Reactor& reactor) : _host(host), _socket(&socket), _reactor(&reactor)
 {
     _pcb.new_phase(TCU_PHASE_INITIALIZE);
-
-    if (_socket.get_socket() < 0)
-    {
-        exit(EXIT_FAILURE);
-    }
-
-    if (_socket.set_non_blocking() < 0)
-    {
-        exit(EXIT_FAILURE);
-    }
-
-    int buff_size = 3000000;
-    if (setsockopt(_socket.get_socket(), SOL_SOCKET, SO_RCVBUF, &buff_size, sizeof(buff_size)) < 0)
-    {
-        perror("setsockopt SO_RCVBUF");
-    }
-    if (setsockopt(_socket.get_socket(), SOL_SOCKET, SO_SNDBUF, &buff_size, sizeof(buff_size)) < 0)
-    {
-        perror("setsockopt SO_SNDBUF");
-    }
+    _pcb.src_port = host.get_port();
 
     const char* home_dir = std::getenv("HOME");
     if (home_dir != nullptr)
@@ -41,42 +23,63 @@ Node::Node() : _socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP), _receive_running(false
     _max_frag_size = TCU_MAX_PAYLOAD_LEN;
     _seq_num = 1;
     _last_num = 0;
+    _final_num = 0;
+    _send_base = 1;
+    _send_next = 1;
+    _send_first = 1;
+    _send_last = 0;
+    _recv_next = 1;
     _ack_received = false;
 
     _window_size = 0;
     _dynamic_window = true;
+
+    _congestion = CongestionControl::create("reno");
+
+    _keep_alive_timer = _reactor->add_timer([this](uint32_t) { keep_alive_timeout(); });
+    if (_keep_alive_timer < 0)
+    {
+        exit(EXIT_FAILURE);
+    }
 }
 
 Node::~Node()
 {
-    _pcb.new_phase(TCU_PHASE_DEAD);
+    new_phase(TCU_PHASE_DEAD);
 
-    stop_receiving();
     stop_keep_alive();
 
-    _socket.close_socket();
+    // Freed peer never waits for disk, host waits for writers at exit
+    FileWriter::retire(std::move(_file_writer));
+
+    std::lock_guard<std::mutex> lock(_timer_mutex);
+    _reactor->remove_timer(_keep_alive_timer);
 }
 
-void Node::set_port(uint16_t port)
+void Node::new_phase(int phase)
 {
-    _pcb.src_port = port;
-    sockaddr_in local_addr{};
-    local_addr.sin_family = AF_INET;
-    local_addr.sin_port = htons(_pcb.src_port);
-    local_addr.sin_addr.s_addr = INADDR_ANY;
+    _pcb.new_phase(phase);
 
-    if (bind(_socket.get_socket(), reinterpret_cast<struct sockaddr*>(&local_addr), sizeof(local_addr)) < 0)
+    // Open from connect until disconnect, shares of host receive buffer follow
+    bool open = phase >= TCU_PHASE_CONNECT && phase <= TCU_PHASE_DISCONNECT;
+    if (_counted.exchange(open) != open)
     {
-        perror("bind");
-        exit(EXIT_FAILURE);
+        _host.count_connection(open);
     }
 
-    if (_pcb.dest_port != 0 && _pcb.dest_ip.s_addr != 0)
+    // Closed peer leaves connection table, its buffers are freed
+    if (phase == TCU_PHASE_HOLDOFF || phase == TCU_PHASE_CLOSED)
     {
-        start_receiving();
+        _host.release_peer(this);
     }
 }
 
+void Node::set_port(uint16_t port)
+{
+    // Socket is bound by host
+    _pcb.src_port = port;
+}
+
 void Node::set_dest(in_addr ip, uint16_t port)
 {
     _pcb.dest_ip = ip;
@@ -84,11 +87,6 @@ void Node::set_dest(in_addr ip, uint16_t port)
     _pcb.dest_addr.sin_family = AF_INET;
     _pcb.dest_addr.sin_port = htons(_pcb.dest_port);
     _pcb.dest_addr.sin_addr = _pcb.dest_ip;
-
-    if (_pcb.src_port != 0)
-    {
-        start_receiving();
-    }
 }
 
 void Node::set_path(std::string& path)
@@ -117,14 +115,144 @@ void Node::set_path(std::string& path)
 
 void Node::set_max_frag_size(size_t size)
 {
-    _max_frag_size = size;
-    spdlog::info("[Node::set_max_frag_size] set max fragment size {}", size);
+    _frag_size_limit = size;
+    _max_frag_size = std::min(size, _path_payload);
+    spdlog::info("[Node::set_max_frag_size] set max fragment size {}, path allows {}", size, _path_payload);
+}
+
+void Node::set_path_probing(bool enabled)
+{
+    _path_probing = enabled;
+    spdlog::info("[Node::set_path_probing] path mtu discovery {}", enabled ? "on" : "off");
+}
+
+void Node::copy_settings(Node& other)
+{
+    _file_path = other._file_path;
+    _direct_file = other._direct_file;
+
+    _frag_size_limit = other._frag_size_limit;
+    _max_frag_size = std::min(_frag_size_limit, _path_payload);
+    _path_probing = other._path_probing;
+
+    _dynamic_window = other._dynamic_window;
+    _window_size = other._window_size;
+    _receive_buffer_len = other._receive_buffer_len;
+
+    _error_rate = other._error_rate;
+    _packet_loss_rate = other._packet_loss_rate;
+    _window_loss_rate = other._window_loss_rate;
+
+    _pacer.set_ceiling(other._pacer.get_ceiling());
+    _pacer.set_burst(other._pacer.get_burst());
+
+    std::string congestion;
+    {
+        std::lock_guard<std::mutex> lock(other._send_mutex);
+        congestion = other._congestion->get_name();
+    }
+
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    _congestion = CongestionControl::create(congestion);
+}
+
+void Node::reset_path_mtu()
+{
+    // New path, only Ethernet payload is assumed until probed
+    _path_probed = false;
+    _path_payload = TCU_MAX_PAYLOAD_LEN;
+    _max_frag_size = std::min(_frag_size_limit, _path_payload);
+}
+
+void Node::discover_path_mtu()
+{
+    _path_probed = true;
+
+    if (_pcb.phase < TCU_PHASE_CONNECT || _pcb.phase > TCU_PHASE_NETWORK)
+    {
+        return;
+    }
+
+    size_t low = TCU_MAX_PAYLOAD_LEN;
+    size_t high = std::min<size_t>(_frag_size_limit, TCU_MAX_PROBE_LEN);
+
+    auto start_time = std::chrono::steady_clock::now();
+    size_t probes = 0;
+
+    // Binary search, sizes above local interface MTU fail at once without waiting
+    while (low < high && _pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
+    {
+        size_t length = (low + high + 1) / 2;
+        probes++;
+
+        if (probe_path(length))
+        {
+            low = length;
+        }
+        else
+        {
+            high = length - 1;
+        }
+    }
+
+    _path_payload = low;
+    _max_frag_size = std::min(_frag_size_limit, _path_payload);
+
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+    spdlog::info("[Node::discover_path_mtu] path carries {} byte fragments ({} byte datagrams), {} probes in {} ms, fragment size {}", _path_payload, _path_payload + TCU_HDR_LEN, probes, duration, _max_frag_size);
+}
+
+bool Node::probe_path(size_t length)
+{
+    // KA with padding, answered with its length
+    tcu_packet probe{};
+    probe.header.flags = TCU_HDR_FLAG_KA;
+    probe.header.length = static_cast<uint16_t>(length);
+    probe.header.seq_number = 0;
+    std::memset(probe.alloc_payload(length), 0, length);
+    probe.calculate_crc();
+
+    unsigned char header[TCU_HDR_LEN];
+    probe.write_header(header);
+
+    struct iovec iov[2] = {{header, TCU_HDR_LEN}, {probe.payload, length}};
+
+    struct msghdr msg{};
+    msg.msg_name = &_pcb.dest_addr;
+    msg.msg_namelen = sizeof(_pcb.dest_addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+
+    for (int attempt = 0; attempt < TCU_PMTU_PROBE_COUNT; attempt++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_send_mutex);
+            _probe_acked = 0;
+        }
+
+        if (sendmsg(_socket.load()->get_socket(), &msg, 0) < 0)
+        {
+            // Larger than local interface allows
+            spdlog::info("[Node::probe_path] probe {} not sent: {}", length, strerror(errno));
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock(_send_mutex);
+        if (_send_cv.wait_for(lock, _pcb.rtt.rto(), [&]() { return _probe_acked == length; }))
+        {
+            spdlog::info("[Node::probe_path] probe {} acknowledged", length);
+            return true;
+        }
+    }
+
+    spdlog::info("[Node::probe_path] probe {} lost {} times", length, TCU_PMTU_PROBE_COUNT);
+    return false;
 }
 
 
 void Node::set_window_size(uint24_t size)
 {
-    _window_size = size;
+    _window_size = static_cast<uint32_t>(size);
     _dynamic_window = false;
     spdlog::info("[Node::set_window_size] set manual window size {}", _window_size);
 
@@ -175,333 +303,735 @@ void Node::set_window_loss_rate(double rate)
     }
 }
 
-void Node::dynamic_window_size()
+void Node::set_receive_buffer(size_t size)
 {
-    _window_size = std::max(uint24_t(1), _total_num / uint24_t(5)); // 20 %
-    spdlog::info("[Node::set_window_size] set dynamic window size {}", _window_size);
+    _receive_buffer_len = size;
+    spdlog::info("[Node::set_receive_buffer] set receive buffer budget {}", size);
 }
 
-void Node::start_receiving()
+void Node::set_direct_file(bool enabled)
 {
-    if (!_receive_running)
-    {
-        _receive_running = true;
-        _receive_thread = std::thread(&Node::receive_loop, this);
-    }
+    _direct_file = enabled;
+    spdlog::info("[Node::set_direct_file] direct file placement {}", enabled ? "on" : "off");
 }
 
-void Node::stop_receiving()
+void Node::set_rate_ceiling(uint64_t bytes_per_sec)
 {
-    _socket.close_socket();
+    _pacer.set_ceiling(bytes_per_sec);
+    spdlog::info("[Node::set_rate_ceiling] set pacing rate ceiling {} B/s", bytes_per_sec);
+}
 
-    _receive_running = false;
+void Node::set_pacing_burst(size_t packets)
+{
+    _pacer.set_burst(packets);
+    spdlog::info("[Node::set_pacing_burst] set pacing burst {} packets", packets);
+}
 
-    if (_receive_thread.joinable())
+void Node::set_congestion_control(const std::string& name)
+{
+    auto controller = CongestionControl::create(name);
+    if (!controller)
     {
-        _receive_thread.join();
+        std::cout << "unknown congestion control" << std::endl;
+        return;
     }
+
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    _congestion = std::move(controller);
+    spdlog::info("[Node::set_congestion_control] set congestion control {}", name);
 }
 
-void Node::receive_loop()
+std::string Node::get_congestion_report()
 {
-    while (_receive_running)
-    {
-        if (_socket.get_socket() == -1)
-        {
-            break;
-        }
+    std::lock_guard<std::mutex> lock(_send_mutex);
+    return _congestion->report() + "\n" + _pcb.rtt.report();
+}
 
-        receive_packet();
-    }
+void Node::dynamic_window_size()
+{
+    _window_size = std::clamp<uint32_t>(_total_num / 5, 1, TCU_MAX_WINDOW); // 20 %
+    spdlog::info("[Node::set_window_size] set dynamic window size {}", _window_size);
 }
 
 void Node::start_keep_alive()
 {
-    if (_keep_alive_thread.joinable())
-    {
-        _keep_alive_thread.join();
-        _keep_alive_thread = std::thread();
-    }
-
-    _keep_alive_running = true;
-    _keep_alive_thread = std::thread(&Node::keep_alive_loop, this);
+    _keep_alive_attempt = 0;
+    arm_keep_alive(std::chrono::seconds(TCU_ACTIVITY_TIMEOUT_INTERVAL));
 }
 
 void Node::stop_keep_alive()
 {
-    _keep_alive_running = false;
-    if (_keep_alive_thread.joinable())
-    {
-        _keep_alive_thread.join();
-        _keep_alive_thread = std::thread();
-    }
+    std::lock_guard<std::mutex> lock(_timer_mutex);
+    _reactor->disarm_timer(_keep_alive_timer);
+}
+
+void Node::arm_keep_alive(std::chrono::seconds delay)
+{
+    std::lock_guard<std::mutex> lock(_timer_mutex);
+    _reactor->arm_timer(_keep_alive_timer, delay);
+}
+
+bool Node::homed_on(const Reactor& reactor)
+{
+    std::lock_guard<std::mutex> lock(_timer_mutex);
+    return _reactor == &reactor;
 }
 
-void Node::keep_alive_loop()
+void Node::move_to(Socket& socket, Reactor& reactor)
 {
-    while (_keep_alive_running)
+    int timer = reactor.add_timer([this](uint32_t) { keep_alive_timeout(); });
+    if (timer < 0)
     {
-        bool ack_received = false;
+        spdlog::warn("[Node::move_to] cannot create timer, peer stays on its shard");
+        return;
+    }
 
-        // Waiting for TCU_ACTIVITY_TIMEOUT_INTERVAL before activity check
-        auto start_time = std::chrono::steady_clock::now();
-        while (_keep_alive_running && std::chrono::steady_clock::now() - start_time < std::chrono::seconds(TCU_ACTIVITY_TIMEOUT_INTERVAL))
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        }
+    _socket.store(&socket, std::memory_order_release);
 
-        if (!_keep_alive_running)
-        {
-            break;
-        }
+    std::lock_guard<std::mutex> lock(_timer_mutex);
+    Reactor* old_reactor = _reactor;
+
+    // Handed over on old loop, its timer handler cannot run meanwhile, armed time carries over
+    old_reactor->post([this, old_reactor, &reactor, timer]() {
+        std::lock_guard<std::mutex> lock(_timer_mutex);
 
-        // Check activity by sending TCU_ACTIVITY_ATTEMPT_COUNT keep-alive messages
-        for (int i = 0; i < TCU_ACTIVITY_ATTEMPT_COUNT && _keep_alive_running; i++)
+        std::chrono::nanoseconds remaining = old_reactor->get_timer(_keep_alive_timer);
+        if (remaining.count() > 0)
         {
-            spdlog::info("[Node::keep_alive_loop] sending tcu keep-alive request {}", i + 1);
-            send_keep_alive_req();
+            reactor.arm_timer(timer, remaining);
+        }
 
-            // Wait for acknowledgment for TCU_ACTIVITY_ATTEMPT_INTERVAL
-            auto attempt_start = std::chrono::steady_clock::now();
-            while (_keep_alive_running && std::chrono::steady_clock::now() - attempt_start < std::chrono::seconds(TCU_ACTIVITY_ATTEMPT_INTERVAL))
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-            }
+        old_reactor->remove_timer(_keep_alive_timer);
+        _keep_alive_timer = timer;
+        _reactor = &reactor;
 
-            if (!_keep_alive_running)
-            {
-                break;
-            }
+        spdlog::info("[Node::move_to] peer {}:{} moved to receiving shard", inet_ntoa(_pcb.dest_ip), _pcb.dest_port);
+    });
+}
 
-            if (_pcb.is_activity_recent())
-            {
-                ack_received = true;
-                break;
-            }
-        }
+void Node::keep_alive_timeout()
+{
+    // Activity seen since last request, back to idle timeout
+    if (_keep_alive_attempt > 0 && _pcb.is_activity_recent())
+    {
+        _keep_alive_attempt = 0;
+        _pcb.is_active.store(false, std::memory_order_relaxed);
+        arm_keep_alive(std::chrono::seconds(TCU_ACTIVITY_TIMEOUT_INTERVAL));
+        return;
+    }
 
-        // If not get acknowledgment, close connection
-        if (!ack_received)
-        {
-            spdlog::info("[Node::keep_alive_loop] no tcu keep-alive acknowledgment, closing connection");
+    // If not get acknowledgment, close connection
+    if (_keep_alive_attempt >= TCU_ACTIVITY_ATTEMPT_COUNT)
+    {
+        spdlog::info("[Node::keep_alive_timeout] no tcu keep-alive acknowledgment, closing connection");
 
-            _keep_alive_running = false;
-            _pcb.new_phase(TCU_PHASE_HOLDOFF);
+        _keep_alive_attempt = 0;
+        new_phase(TCU_PHASE_HOLDOFF);
 
-            std::cout << "destination node down, connection closed" << std::endl;
-        }
-        else
-        {
-            _pcb.is_active.store(false, std::memory_order_relaxed);
-        }
+        std::cout << "destination node down, connection closed" << std::endl;
+        return;
     }
+
+    // Check activity by sending TCU_ACTIVITY_ATTEMPT_COUNT keep-alive messages
+    _keep_alive_attempt++;
+    spdlog::info("[Node::keep_alive_timeout] sending tcu keep-alive request {}", _keep_alive_attempt.load());
+    send_keep_alive_req();
+
+    arm_keep_alive(std::chrono::seconds(TCU_ACTIVITY_ATTEMPT_INTERVAL));
 }
 
-void Node::receive_packet()
+size_t Node::prepare_packet(const tcu_packet& packet, bool service, unsigned char* header, struct iovec* iov, unsigned char* corrupted_byte)
 {
-    char temp_buff[2048];
+    // Header goes to caller storage, payload is sent in place
+    packet.write_header(header);
 
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(_socket.get_socket(), &read_fds);
+    size_t iov_count = 0;
 
-    struct timeval timeout{};
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 50000;
-
-    int result = select(_socket.get_socket() + 1, &read_fds, nullptr, nullptr, &timeout);
+    iov[iov_count++] = {header, TCU_HDR_LEN};
+    if (packet.header.length > 0)
+    {
+        iov[iov_count++] = {packet.payload, packet.header.length};
+    }
 
-    if (result > 0 && FD_ISSET(_socket.get_socket(), &read_fds))
+    // Service packet
+    if (service)
     {
-        struct sockaddr_in src_addr{};
-        socklen_t src_addr_len = sizeof(src_addr);
+        return iov_count;
+    }
 
-        ssize_t num_bytes = recvfrom(_socket.get_socket(), temp_buff, sizeof(temp_buff), 0, (struct sockaddr*)&src_addr, &src_addr_len);
+    // Data packet
 
-        if (num_bytes < 0)
+    // Packet loss simulation
+    if (_dist(_gen) < _packet_loss_rate)
+    {
+        spdlog::info("[Node::prepare_packet] simulated packet loss");
+        return 0;
+    }
+
+    // Packet corruption simulation, last byte is replaced without touching stored packet
+    if (_dist(_gen) < _error_rate)
+    {
+        if (packet.header.length > 0)
         {
-            perror("recvfrom");
+            *corrupted_byte = packet.payload[packet.header.length - 1] ^ 0xFF;
+            iov[iov_count - 1].iov_len--;
+            iov[iov_count++] = {corrupted_byte, 1};
         }
         else
         {
-            spdlog::info("[Node::receive_packet] received {} bytes from {}:{}", num_bytes, inet_ntoa(src_addr.sin_addr), ntohs(src_addr.sin_port));
-            
-            fsm_process(reinterpret_cast<unsigned char*>(temp_buff), static_cast<size_t>(num_bytes));
+            header[TCU_HDR_LEN - 1] ^= 0xFF;
         }
+        spdlog::info("[Node::prepare_packet] simulated packet corruption");
     }
-    else if (result < 0)
-    {
-        perror("select");
-    }
+
+    return iov_count;
 }
 
-void Node::send_packet(unsigned char* buff, size_t length, bool service)
+void Node::queue_packets(const tcu_packet* const* packets, size_t count, bool service, Transmitter& transmitter)
 {
-    // Service packet
-    if (service)
+    uint64_t allocs_before = thread_alloc_count();
+
+    tx_datagram datagrams[SOCKET_MAX_BATCH];
+
+    // Copied out of retransmission buffer, acknowledgment may release fragment before it is sent
+    size_t ready = 0;
+    for (size_t i = 0; i < count && i < SOCKET_MAX_BATCH; i++)
     {
-        ssize_t num_bytes = sendto(_socket.get_socket(), buff, length, 0, reinterpret_cast<struct sockaddr*>(&_pcb.dest_addr), sizeof(_pcb.dest_addr));
+        unsigned char header[TCU_HDR_LEN];
+        unsigned char corrupted_byte;
+        struct iovec iov[3];
 
-        if (num_bytes < 0)
+        size_t iov_count = prepare_packet(*packets[i], service, header, iov, &corrupted_byte);
+        if (iov_count == 0)
         {
-            perror("sendto");
+            continue;
         }
-        else
+
+        size_t length = 0;
+        for (size_t j = 0; j < iov_count; j++)
         {
-            spdlog::info("[Node::send_packet] sent {} bytes to {}:{}", num_bytes, inet_ntoa(_pcb.dest_addr.sin_addr), ntohs(_pcb.dest_addr.sin_port));
+            length += iov[j].iov_len;
         }
 
+        tx_datagram& datagram = datagrams[ready++];
+        datagram.buffer = PoolBuffer::allocate(length);
+        datagram.length = length;
+        datagram.addr = _pcb.dest_addr;
+
+        size_t offset = 0;
+        for (size_t j = 0; j < iov_count; j++)
+        {
+            std::memcpy(datagram.buffer.data() + offset, iov[j].iov_base, iov[j].iov_len);
+            offset += iov[j].iov_len;
+        }
+    }
+
+    if (ready == 0)
+    {
         return;
     }
 
-    // Data packet
+    size_t queued = transmitter.push(datagrams, ready);
 
-    // Packet loss simulation
-    if (_dist(_gen) < _packet_loss_rate)
+    Stats::get_instance().tx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+
+    spdlog::info("[Node::queue_packets] queued {}/{} packets for {}:{}", queued, ready, inet_ntoa(_pcb.dest_addr.sin_addr), ntohs(_pcb.dest_addr.sin_port));
+}
+
+void Node::send_packet(const tcu_packet& packet, bool service)
+{
+    if (Transmitter* transmitter = _host.get_transmitter())
     {
-        spdlog::info("[Node::send_packet] simulated packet loss");
+        const tcu_packet* single = &packet;
+        queue_packets(&single, 1, service, *transmitter);
         return;
     }
 
-    // Packet corruption simulation
-    auto* temp_buff = new unsigned char[length];
-    std::memcpy(temp_buff, buff, length);
+    uint64_t allocs_before = thread_alloc_count();
 
-    if (_dist(_gen) < _error_rate)
+    unsigned char header[TCU_HDR_LEN];
+    unsigned char corrupted_byte;
+    struct iovec iov[3];
+
+    size_t iov_count = prepare_packet(packet, service, header, iov, &corrupted_byte);
+    if (iov_count == 0)
     {
-        temp_buff[length - 1] ^= 0xFF;
-        spdlog::info("[Node::send_packet] simulated packet corruption");
+        return;
     }
 
-    ssize_t num_bytes = sendto(_socket.get_socket(), temp_buff, length, 0,reinterpret_cast<struct sockaddr*>(&_pcb.dest_addr), sizeof(_pcb.dest_addr));
+    struct msghdr msg{};
+    msg.msg_name = &_pcb.dest_addr;
+    msg.msg_namelen = sizeof(_pcb.dest_addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+
+    ssize_t num_bytes = sendmsg(_socket.load()->get_socket(), &msg, 0);
+
+    Stats& stats = Stats::get_instance();
+    stats.tx_packets.fetch_add(1, std::memory_order_relaxed);
+    stats.tx_syscalls.fetch_add(1, std::memory_order_relaxed);
+    stats.tx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
 
     if (num_bytes < 0)
     {
-        perror("sendto");
+        perror("sendmsg");
     }
     else
     {
         spdlog::info("[Node::send_packet] sent {} bytes to {}:{}", num_bytes, inet_ntoa(_pcb.dest_addr.sin_addr), ntohs(_pcb.dest_addr.sin_port));
     }
+}
+
+void Node::send_packet_batch(const tcu_packet* const* packets, size_t count, bool service)
+{
+    if (Transmitter* transmitter = _host.get_transmitter())
+    {
+        queue_packets(packets, count, service, *transmitter);
+        return;
+    }
+
+    uint64_t allocs_before = thread_alloc_count();
+
+    unsigned char headers[SOCKET_MAX_BATCH][TCU_HDR_LEN];
+    unsigned char corrupted_bytes[SOCKET_MAX_BATCH];
+    struct iovec iov[SOCKET_MAX_BATCH][3];
+    struct mmsghdr msgs[SOCKET_MAX_BATCH];
+
+    size_t ready = 0;
+    for (size_t i = 0; i < count && i < SOCKET_MAX_BATCH; i++)
+    {
+        size_t iov_count = prepare_packet(*packets[i], service, headers[ready], iov[ready], &corrupted_bytes[ready]);
+        if (iov_count == 0)
+        {
+            continue;
+        }
+
+        msgs[ready] = {};
+        msgs[ready].msg_hdr.msg_name = &_pcb.dest_addr;
+        msgs[ready].msg_hdr.msg_namelen = sizeof(_pcb.dest_addr);
+        msgs[ready].msg_hdr.msg_iov = iov[ready];
+        msgs[ready].msg_hdr.msg_iovlen = iov_count;
+        ready++;
+    }
+
+    if (ready == 0)
+    {
+        return;
+    }
+
+    int sent = _socket.load()->send_batch(msgs, ready);
 
-    delete[] temp_buff;
+    Stats& stats = Stats::get_instance();
+    stats.tx_packets.fetch_add(sent > 0 ? sent : 0, std::memory_order_relaxed);
+    stats.tx_syscalls.fetch_add(1, std::memory_order_relaxed);
+    stats.tx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+
+    spdlog::info("[Node::send_packet_batch] sent {}/{} packets to {}:{}", sent, ready, inet_ntoa(_pcb.dest_addr.sin_addr), ntohs(_pcb.dest_addr.sin_port));
 }
 
-void Node::wait_for_conf_ack()
+void Node::send_packet_segmented(const tcu_packet* const* packets, size_t count)
 {
-    spdlog::info("[Node::wait_for_conf_ack] waiting for tcu connection acknowledgment");
+    uint64_t allocs_before = thread_alloc_count();
 
-    auto start_time = std::chrono::steady_clock::now();
-    while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(TCU_CONFIRM_TIMEOUT_INTERVAL))
+    unsigned char headers[SOCKET_MAX_BATCH][TCU_HDR_LEN];
+    unsigned char corrupted_bytes[SOCKET_MAX_BATCH];
+    struct iovec iov[SOCKET_MAX_BATCH * 3];
+    size_t iov_first[SOCKET_MAX_BATCH + 1];
+    size_t sizes[SOCKET_MAX_BATCH];
+
+    // Prepare all packets into one iovec array, lost ones are skipped
+    size_t ready = 0;
+    size_t iov_used = 0;
+    for (size_t i = 0; i < count && i < SOCKET_MAX_BATCH; i++)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        size_t iov_count = prepare_packet(*packets[i], false, headers[ready], iov + iov_used, &corrupted_bytes[ready]);
+        if (iov_count == 0)
+        {
+            continue;
+        }
+
+        iov_first[ready] = iov_used;
+        sizes[ready] = TCU_HDR_LEN + packets[i]->header.length;
+        iov_used += iov_count;
+        ready++;
+    }
+    iov_first[ready] = iov_used;
+
+    Stats& stats = Stats::get_instance();
+
+    // Group equal sized datagrams, only last one of group can be shorter
+    size_t start = 0;
+    while (start < ready)
+    {
+        size_t segment_size = sizes[start];
+        size_t max_segments = std::min<size_t>(SOCKET_GSO_MAX_SEGMENTS, SOCKET_GSO_MAX_BYTES / segment_size);
+
+        size_t end = start + 1;
+        while (end < ready && end - start < max_segments && sizes[end - 1] == segment_size && sizes[end] <= segment_size)
+        {
+            end++;
+        }
+
+        ssize_t num_bytes = -1;
+        if (_host.offload_enabled())
+        {
+            num_bytes = _socket.load()->send_segmented(_pcb.dest_addr, iov + iov_first[start], iov_first[end] - iov_first[start], static_cast<uint16_t>(segment_size));
+            if (num_bytes < 0)
+            {
+                // Device or kernel refused segmentation, fall back to per-packet sends
+                spdlog::warn("[Node::send_packet_segmented] segmentation offload failed ({}), disabled", strerror(errno));
+                _host.disable_offload();
+            }
+            else
+            {
+                stats.tx_packets.fetch_add(end - start, std::memory_order_relaxed);
+                stats.tx_syscalls.fetch_add(1, std::memory_order_relaxed);
+                spdlog::info("[Node::send_packet_segmented] sent {} segments of {} bytes to {}:{}", end - start, segment_size, inet_ntoa(_pcb.dest_addr.sin_addr), ntohs(_pcb.dest_addr.sin_port));
+            }
+        }
 
-        if (_ack_received)
+        if (num_bytes < 0)
+        {
+            for (size_t i = start; i < end; i++)
+            {
+                struct msghdr msg{};
+                msg.msg_name = &_pcb.dest_addr;
+                msg.msg_namelen = sizeof(_pcb.dest_addr);
+                msg.msg_iov = iov + iov_first[i];
+                msg.msg_iovlen = iov_first[i + 1] - iov_first[i];
+
+                if (sendmsg(_socket.load()->get_socket(), &msg, 0) < 0)
+                {
+                    perror("sendmsg");
+                }
+                stats.tx_packets.fetch_add(1, std::memory_order_relaxed);
+                stats.tx_syscalls.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        start = end;
+    }
+
+    stats.tx_allocs.fetch_add(thread_alloc_count() - allocs_before, std::memory_order_relaxed);
+}
+
+void Node::wait_for_conf_ack(const tcu_packet& request)
+{
+    spdlog::info("[Node::wait_for_conf_ack] waiting for tcu connection acknowledgment");
+
+    auto give_up = std::chrono::steady_clock::now() + std::chrono::seconds(TCU_CONFIRM_TIMEOUT_INTERVAL);
+    std::unique_lock<std::mutex> lock(_send_mutex);
+
+    while (std::chrono::steady_clock::now() < give_up)
+    {
+        // Woken by acknowledgment handler, handshake completes one round trip after request
+        auto deadline = std::min(std::chrono::steady_clock::now() + _pcb.rtt.rto(), give_up);
+        if (_send_cv.wait_until(lock, deadline, [this]() { return _ack_received.load(); }))
         {
             _ack_received = false;
             return;
         }
+
+        if (std::chrono::steady_clock::now() >= give_up)
+        {
+            break;
+        }
+
+        // Request or its acknowledgment lost, resend with doubled timeout
+        _pcb.rtt.backoff();
+        _conf_retransmitted = true;
+
+        spdlog::info("[Node::wait_for_conf_ack] no tcu acknowledgment, resending request, rto {} us", _pcb.rtt.rto().count());
+        send_packet(request, true);
     }
 
+    lock.unlock();
+
     spdlog::info("[Node::wait_for_conf_ack] no tcu acknowledgment, closing connection");
-    _pcb.new_phase(TCU_PHASE_HOLDOFF);
+    new_phase(TCU_PHASE_HOLDOFF);
     stop_keep_alive();
     std::cout << "destination node down, connection closed" << std::endl;
 }
 
+void Node::sample_conf_rtt()
+{
+    // Karn, answer to resent request may belong to either copy
+    if (_conf_retransmitted)
+    {
+        return;
+    }
+
+    auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _conf_sent.load());
+    _pcb.rtt.sample(rtt);
+    spdlog::info("[Node::sample_conf_rtt] handshake round trip {} us", rtt.count());
+}
+
 void Node::wait_for_recv_ack()
 {
     spdlog::info("[Node::wait_for_recv_ack] waiting for tcu receive acknowledgment");
 
-    int retry_count = 0;
-    int max_retries = TCU_ACTIVITY_ATTEMPT_COUNT;
+    auto start_time = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(_send_mutex);
 
-    while (retry_count < max_retries)
+    while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(TCU_RECEIVE_TIMEOUT_INTERVAL))
     {
-        auto start_time = std::chrono::steady_clock::now();
-        while (std::chrono::steady_clock::now() - start_time < std::chrono::seconds(TCU_RECEIVE_TIMEOUT_INTERVAL))
+        if (_send_cv.wait_for(lock, _pcb.rtt.rto(), [this]() { return _ack_received || _pcb.phase != TCU_PHASE_NETWORK; }))
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
-
-            if (_ack_received)
-            {
-                _ack_received = false;
-                return;
-            }
+            _ack_received = false;
+            return;
         }
-        retry_count++;
 
-        spdlog::info("[Node::wait_for_recv_ack] no tcu receive acknowledgment, resending window {}/{}", retry_count, max_retries);
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        send_window();
+        // Timer expired, resend and wait twice as long
+        _pcb.rtt.backoff();
+        spdlog::info("[Node::wait_for_recv_ack] no tcu receive acknowledgment, resending packet, rto {} us", _pcb.rtt.rto().count());
+
+        _send_packets.for_each([this](uint32_t, tcu_packet& packet) { send_packet(packet, false); });
     }
 
+    lock.unlock();
+
     spdlog::error("[Node::wait_for_recv_ack] no tcu receive acknowledgment, closing connection");
-    _pcb.new_phase(TCU_PHASE_HOLDOFF);
+    new_phase(TCU_PHASE_HOLDOFF);
     stop_keep_alive();
     std::cout << "destination node down, connection closed" << std::endl;
 }
 
-
 void Node::assemble_text()
 {
-    std::vector<uint24_t> seq_numbers;
-    for (auto& entry : _received_packets)
-    {
-        seq_numbers.push_back(entry.first);
-    }
-    std::sort(seq_numbers.begin(), seq_numbers.end());
+    // Fragments were consumed in order as they arrived, checksum closing them leaves zero remainder
+    bool intact = _received_data.size() >= TCU_MESSAGE_CRC_LEN && _message_crc.final() == 0;
+    size_t length = intact ? _received_data.size() - TCU_MESSAGE_CRC_LEN : 0;
+    std::string message(reinterpret_cast<const char*>(_received_data.data()), length);
 
-    std::string message;
-    for (uint24_t seq : seq_numbers)
+    finish_message();
+
+    // Compute duration
+    auto receive_end_time = std::chrono::steady_clock::now();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(receive_end_time - _receive_start_time_text).count();
+
+    if (!intact)
     {
-        tcu_packet& pkt = _received_packets[seq];
-        message.append(reinterpret_cast<char*>(pkt.payload), pkt.header.length);
+        spdlog::error("[Node::assemble_text] text message checksum mismatch, time {}", duration);
+        std::cout << "error text checksum, message discarded" << std::endl;
+        return;
     }
 
-    _received_packets.clear();
+    // Log information
+    spdlog::info("[Node::assemble_text] received text message size {} time {}", message.size(), duration);
+
+    std::cout << "received text " << message << std::endl;
+}
 
+void Node::assemble_file()
+{
     // Compute duration
     auto receive_end_time = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(receive_end_time - _receive_start_time_text).count();
+    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(receive_end_time - _receive_start_time_file).count();
+
+    // Checksum closing message leaves zero remainder
+    bool intact = _message_crc.final() == 0;
+
+    if (_direct_file && _file_writer)
+    {
+        // Data is already on its way to disk, writer reports once last chunk is placed
+        if (intact)
+        {
+            _file_writer->finish();
+            spdlog::info("[Node::assemble_file] received file message size {} time {}", _file_writer->get_received(), duration);
+        }
+        else
+        {
+            _file_writer->discard();
+            spdlog::error("[Node::assemble_file] file {} checksum mismatch, time {}", _file_writer->get_path(), duration);
+            std::cout << "error file checksum, file discarded" << std::endl;
+        }
+
+        finish_message();
+        return;
+    }
+
+    if (!intact)
+    {
+        finish_message();
+
+        spdlog::error("[Node::assemble_file] file message checksum mismatch, time {}", duration);
+        std::cout << "error file checksum, file discarded" << std::endl;
+        return;
+    }
+
+    File file = File::from_buff(_received_data.data());
+
+    finish_message();
+
+    // Log information
+    spdlog::info("[Node::assemble_file] received file message size {} time {}", file.get_size(), duration);
+
+    save_file(file);
+}
+
+void Node::start_message(bool file)
+{
+    // Start timer when first fragment received
+    if (file)
+    {
+        _receive_start_time_file = std::chrono::steady_clock::now();
+        FileWriter::retire(std::move(_file_writer));
+        std::cout << "receiving file..." << std::endl;
+    }
+    else
+    {
+        _receive_start_time_text = std::chrono::steady_clock::now();
+        std::cout << "receiving text..." << std::endl;
+    }
+
+    _receiving = true;
+    _recv_frag_size = 0;
+    _final_num = 0;
+    _message_crc.init();
+}
+
+void Node::finish_message()
+{
+    // Numbering continues with next message, late copies of this one stay below next expected fragment
+    _received_data.clear();
+    _received_packets.reset(_recv_next);
+    _received_bytes = 0;
+
+    _receiving = false;
+    _final_num = 0;
+}
+
+void Node::reset_numbering()
+{
+    // Peers that never connect hold no fragment buffers
+    _received_packets.allocate();
+
+    {
+        std::lock_guard<std::mutex> lock(_send_mutex);
+        _send_packets.allocate();
+        _send_packets.reset(1);
+        _send_base = 1;
+        _send_next = 1;
+        _ack_points.clear();
+        _resent.assign(_resent.size(), resend_mark{});
+    }
+
+    _recv_next = 1;
+    _last_num = 0;
+    _message_crc.init();
+    finish_message();
+}
+
+void Node::store_fragment(const tcu_packet_view& packet, uint32_t seq)
+{
+    // Already consumed or already waiting in reorder buffer
+    if (seq < _recv_next || _received_packets.contains(seq))
+    {
+        spdlog::info("[Node::store_fragment] duplicate packet {}", seq);
+        return;
+    }
+
+    // Sender stays within advertised window, which never exceeds reorder buffer
+    if (!_received_packets.in_range(seq))
+    {
+        spdlog::warn("[Node::store_fragment] packet {} beyond reorder buffer, next {}", seq, _recv_next);
+        return;
+    }
+
+    _recv_frag_size = std::max<size_t>(_recv_frag_size, packet.header.length);
+    Stats::get_instance().rx_copies.fetch_add(1, std::memory_order_relaxed);
+
+    if (seq != _recv_next)
+    {
+        // Out of order, only copy of received payload is held until gap is filled
+        _received_packets.insert(seq, tcu_packet(packet));
+        _received_bytes += packet.header.length;
+        return;
+    }
+
+    // In order, consumed straight from receive buffer together with fragments it unblocks
+    bool file = packet.header.flags & TCU_HDR_FLAG_FL;
+
+    consume_fragment(packet.payload, packet.header.length, file);
+    _received_packets.release_until(seq, [](uint32_t, tcu_packet&) {});
+
+    _received_packets.drain([this, file](uint32_t, tcu_packet& stored)
+    {
+        consume_fragment(stored.payload, stored.header.length, file);
+        _received_bytes -= stored.header.length;
+    });
+
+    _recv_next = _received_packets.base();
+}
+
+void Node::consume_fragment(const unsigned char* data, size_t length, bool file)
+{
+    _message_crc.update(data, length);
+
+    if (!file || !_direct_file)
+    {
+        _received_data.insert(_received_data.end(), data, data + length);
+        return;
+    }
+
+    if (_file_writer)
+    {
+        _file_writer->write(data, length);
+        return;
+    }
+
+    // Name and size lead file data, may span several small fragments
+    size_t before = _received_data.size();
+    _received_data.insert(_received_data.end(), data, data + length);
 
-    // Log information
-    spdlog::info("[Node::assemble_text] received text message size {} time {}", message.size(), duration);
+    size_t header_len = sizeof(uint8_t) + _received_data[0] + sizeof(FileHeader::file_size);
+    if (_received_data.size() < header_len || before >= header_len)
+    {
+        return;
+    }
 
-    std::cout << "received text " << message << std::endl;
-}
+    FileHeader header = File::header_from_buff(_received_data.data());
+    std::string save_path = _file_path + '/' + header.file_name;
 
-void Node::assemble_file()
-{
-    std::vector<uint24_t> seq_numbers;
-    for (auto& entry : _received_packets)
+    if (check_file_path())
     {
-        seq_numbers.push_back(entry.first);
+        FileWriter::retire(std::move(_file_writer));
+        _file_writer = FileWriter::open(save_path, header.file_size);
     }
-    std::sort(seq_numbers.begin(), seq_numbers.end());
 
-    std::vector<unsigned char> file_data;
-    for (uint24_t seq : seq_numbers)
+    if (!_file_writer)
     {
-        tcu_packet& pkt = _received_packets[seq];
-        file_data.insert(file_data.end(), pkt.payload, pkt.payload + pkt.header.length);
+        // Target cannot be created, rest of file is assembled in memory
+        spdlog::warn("[Node::consume_fragment] cannot place file {} directly, buffering in memory", save_path);
+        return;
     }
 
-    _received_packets.clear();
+    spdlog::info("[Node::consume_fragment] placing file {} size {} directly", save_path, header.file_size);
 
-    // Compute duration
-    auto receive_end_time = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(receive_end_time - _receive_start_time_file).count();
+    _file_writer->write(_received_data.data() + header_len, _received_data.size() - header_len);
+    _received_data.clear();
+}
 
-    File file = File::from_buff(file_data.data());
+uint24_t Node::advertised_window() const
+{
+    size_t fragment = (_recv_frag_size > 0 ? _recv_frag_size : TCU_MAX_PAYLOAD_LEN) + TCU_HDR_LEN;
 
-    // Log information
-    spdlog::info("[Node::assemble_file] received file message size {} time {}", file.get_size(), duration);
+    // Free reorder budget, in fragments, file data waiting for disk counts as held
+    size_t held = _received_bytes + (_file_writer ? _file_writer->pending() : 0);
+    size_t budget = _receive_buffer_len > held ? _receive_buffer_len - held : 0;
+    size_t window = budget / fragment;
 
-    save_file(file);
+    // Kernel receive buffer is shared by every open connection
+    window = std::min(window, _host.get_receive_share() / fragment);
+
+    // Fragments past reorder buffer would be dropped
+    window = std::min(window, _received_packets.capacity());
+
+    // Never zero, acknowledgments keep carrying window updates
+    return uint24_t(static_cast<uint32_t>(std::clamp<size_t>(window, 1, TCU_MAX_WINDOW)));
 }
 
-void Node::save_file(const File& file)
+bool Node::check_file_path()
 {
     struct stat info{};
 
@@ -509,20 +1039,33 @@ void Node::save_file(const File& file)
     {
         if (mkdir(_file_path.c_str(), 0777) != 0)
         {
-            spdlog::error("[Node::save_file] cannot create directory {}", _file_path);
+            spdlog::error("[Node::check_file_path] cannot create directory {}", _file_path);
             std::cout << "invalid path" << std::endl;
-            return;
+            return false;
         }
     }
     else if (!(info.st_mode & S_IFDIR))
     {
-        spdlog::error("[Node::save_file] {} not directory", _file_path);
+        spdlog::error("[Node::check_file_path] {} not directory", _file_path);
         std::cout << "invalid path" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void Node::save_file(const File& file)
+{
+    if (!check_file_path())
+    {
         return;
     }
 
     std::string save_path = _file_path + '/' + file.get_header().file_name;
 
+    // Earlier transfer of same name may still be draining to disk, this copy is newer
+    FileWriter::supersede(save_path);
+
     std::ofstream outfile(save_path, std::ios::binary);
     if (!outfile)
     {
@@ -536,9 +1079,76 @@ void Node::save_file(const File& file)
     std::cout << "received file " << save_path << std::endl;
 }
 
-void Node::fsm_process(unsigned char* buff, size_t length)
+void Node::enqueue(const unsigned char* buff, size_t length, Executor& executor)
+{
+    if (!_inbox)
+    {
+        _inbox = std::make_unique<spsc_ring<inbound>>(NODE_INBOX_LEN);
+    }
+
+    inbound item{PoolBuffer::allocate(length), length};
+    std::memcpy(item.buffer.data(), buff, length);
+
+    // Workers fell behind, same as socket buffer overflow
+    if (!_inbox->push(std::move(item)))
+    {
+        spdlog::warn("[Node::enqueue] inbox full, datagram dropped");
+        return;
+    }
+
+    size_t depth = _inbox->size();
+    if (depth > _inbox_peak.load(std::memory_order_relaxed))
+    {
+        _inbox_peak.store(depth, std::memory_order_relaxed);
+    }
+
+    // Pairs with fence in drain_inbox, either worker sees datagram or it is scheduled again here
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!_inbox_scheduled.exchange(true, std::memory_order_acq_rel))
+    {
+        executor.submit([this]() { drain_inbox(); });
+    }
+}
+
+void Node::drain_inbox()
+{
+    inbound batch[NODE_INBOX_BATCH];
+
+    while (true)
+    {
+        // Arrival order kept, receiving thread keeps filling ring meanwhile
+        size_t count = _inbox->pop_batch(batch, NODE_INBOX_BATCH);
+        for (size_t i = 0; i < count; i++)
+        {
+            fsm_process(batch[i].buffer.data(), batch[i].length);
+            batch[i].buffer.reset();
+        }
+
+        if (count > 0)
+        {
+            continue;
+        }
+
+        // Release, next drain of this peer on another worker sees every write of this one
+        _inbox_scheduled.store(false, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // Datagram pushed after last pop either shows here or already scheduled new drain
+        if (_inbox->empty() || _inbox_scheduled.exchange(true, std::memory_order_acq_rel))
+        {
+            return;
+        }
+    }
+}
+
+void Node::fsm_process(const unsigned char* buff, size_t length)
 {
-    tcu_packet packet = tcu_packet::from_buff(buff);
+    tcu_packet_view packet;
+    if (!tcu_packet_view::parse(buff, length, packet))
+    {
+        spdlog::warn("[Node::fsm_process] malformed packet length {}", length);
+        return;
+    }
 
     uint16_t flags = packet.header.flags;
 
@@ -605,18 +1215,36 @@ void Node::fsm_process(unsigned char* buff, size_t length)
     }
 }
 
-void Node::process_tcu_conn_req(tcu_packet packet)
+void Node::process_tcu_conn_req(const tcu_packet_view& packet)
 {
     if (_pcb.phase <= TCU_PHASE_INITIALIZE)
     {
         spdlog::info("[Node::process_tcu_conn_req] received tcu connection request");
         _pcb.update_last_activity();
-        _pcb.new_phase(TCU_PHASE_CONNECT);
+        new_phase(TCU_PHASE_CONNECT);
 
+        _pcb.rtt.reset();
+        reset_path_mtu();
+        reset_numbering();
         start_keep_alive();
         std::cout << "connected" << std::endl;
         send_tcu_conn_ack();
     }
+    else if (_pcb.phase == TCU_PHASE_NETWORK)
+    {
+        // Our acknowledgment was lost and request resent
+        spdlog::info("[Node::process_tcu_conn_req] duplicate tcu connection request, resending acknowledgment");
+        _pcb.update_last_activity();
+
+        // SYN + ACK
+        tcu_packet ack{};
+        ack.header.flags = TCU_HDR_FLAG_SYN | TCU_HDR_FLAG_ACK;
+        ack.header.length = 0;
+        ack.header.seq_number = 0;
+        ack.calculate_crc();
+
+        send_packet(ack, true);
+    }
     else
     {
         spdlog::error("[Node::process_tcu_conn_req] unexpected phase {}", _pcb.phase);
@@ -624,17 +1252,25 @@ void Node::process_tcu_conn_req(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_conn_ack(tcu_packet packet)
+void Node::process_tcu_conn_ack(const tcu_packet_view& packet)
 {
     if (_pcb.phase == TCU_PHASE_CONNECT)
     {
         spdlog::info("[Node::process_tcu_conn_ack] received tcu connection acknowledgment");
         _pcb.update_last_activity();
-        _ack_received = true;
+        sample_conf_rtt();
+        reset_numbering();
 
-        _pcb.new_phase(TCU_PHASE_NETWORK);
+        new_phase(TCU_PHASE_NETWORK);
         start_keep_alive();
         std::cout << "connected" << std::endl;
+
+        // Waiter resumes in new phase, set under lock so notification cannot be missed
+        {
+            std::lock_guard<std::mutex> lock(_send_mutex);
+            _ack_received = true;
+        }
+        _send_cv.notify_all();
     }
     else
     {
@@ -643,18 +1279,32 @@ void Node::process_tcu_conn_ack(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_disconn_req(tcu_packet packet)
+void Node::process_tcu_disconn_req(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_disconn_req] received tcu disconnection request");
         _pcb.update_last_activity();
 
-        _pcb.new_phase(TCU_PHASE_DISCONNECT);
+        new_phase(TCU_PHASE_DISCONNECT);
         stop_keep_alive();
         std::cout << "disconnected" << std::endl;
         send_tcu_disconn_ack();
     }
+    else if (_pcb.phase == TCU_PHASE_HOLDOFF)
+    {
+        // Our acknowledgment was lost and request resent
+        spdlog::info("[Node::process_tcu_disconn_req] duplicate tcu disconnection request, resending acknowledgment");
+
+        // FIN + ACK
+        tcu_packet ack{};
+        ack.header.flags = TCU_HDR_FLAG_FIN | TCU_HDR_FLAG_ACK;
+        ack.header.length = 0;
+        ack.header.seq_number = 0;
+        ack.calculate_crc();
+
+        send_packet(ack, true);
+    }
     else
     {
         spdlog::error("[Node::process_tcu_disconn_req] unexpected phase {}", _pcb.phase);
@@ -662,17 +1312,24 @@ void Node::process_tcu_disconn_req(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_disconn_ack(tcu_packet packet)
+void Node::process_tcu_disconn_ack(const tcu_packet_view& packet)
 {
     if (_pcb.phase == TCU_PHASE_DISCONNECT)
     {
         spdlog::info("[Node::process_tcu_disconn_ack] received tcu disconnection acknowledgment");
         _pcb.update_last_activity();
-        _ack_received = true;
+        sample_conf_rtt();
 
-        _pcb.new_phase(TCU_PHASE_HOLDOFF);
+        new_phase(TCU_PHASE_HOLDOFF);
         stop_keep_alive();
         std::cout << "disconnected" << std::endl;
+
+        // Waiter resumes in new phase, set under lock so notification cannot be missed
+        {
+            std::lock_guard<std::mutex> lock(_send_mutex);
+            _ack_received = true;
+        }
+        _send_cv.notify_all();
     }
     else
     {
@@ -681,38 +1338,75 @@ void Node::process_tcu_disconn_ack(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_ka_req(tcu_packet packet)
+void Node::process_tcu_ka_req(const tcu_packet_view& packet)
 {
     spdlog::info("[Node::process_tcu_ka_req] received tcu keep-alive request");
     _pcb.update_last_activity();
 
+    // Path probe, padding made it through
+    if (packet.header.length > 0)
+    {
+        if (packet.validate_crc())
+        {
+            send_probe_ack(packet.header.length);
+        }
+        return;
+    }
+
     send_keep_alive_ack();
 }
 
-void Node::process_tcu_ka_ack(tcu_packet packet)
+void Node::process_tcu_ka_ack(const tcu_packet_view& packet)
 {
     spdlog::info("[Node::process_tcu_ka_ack] received tcu keep-alive acknowledgment");
     _pcb.update_last_activity();
+
+    // Answer to path probe
+    if (packet.header.length == sizeof(uint16_t) && packet.validate_crc())
+    {
+        uint16_t length;
+        std::memcpy(&length, packet.payload, sizeof(length));
+
+        {
+            std::lock_guard<std::mutex> lock(_send_mutex);
+            _probe_acked = ntohs(length);
+        }
+        _send_cv.notify_all();
+    }
 }
 
-void Node::process_tcu_single_text(tcu_packet packet)
+void Node::process_tcu_single_text(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_single_text] received tcu single message");
         _pcb.update_last_activity();
 
+        // Single message takes one fragment number too
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
+
         if (!packet.validate_crc())
         {
             spdlog::warn("[Node::process_tcu_single_text] invalid checksum");
-            send_tcu_negative_ack(packet.header.seq_number);
+            send_tcu_negative_ack(seq, seq);
+            return;
+        }
+
+        // Resent because acknowledgment was lost, delivered once
+        if (seq < _recv_next)
+        {
+            spdlog::info("[Node::process_tcu_single_text] duplicate packet {}", seq);
+            send_tcu_positive_ack(seq);
             return;
         }
 
-        std::string message(reinterpret_cast<char*>(packet.payload), packet.header.length);
+        _recv_next = seq + 1;
+        finish_message();
+
+        std::string message(reinterpret_cast<const char*>(packet.payload), packet.header.length);
         std::cout << "received text " << message << std::endl;
 
-        send_tcu_positive_ack(packet.header.seq_number);
+        send_tcu_positive_ack(seq);
     }
     else
     {
@@ -721,25 +1415,39 @@ void Node::process_tcu_single_text(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_single_file(tcu_packet packet)
+void Node::process_tcu_single_file(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_single_file] received tcu single file");
         _pcb.update_last_activity();
 
+        // Single message takes one fragment number too
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
+
         if (!packet.validate_crc())
         {
             spdlog::warn("[Node::process_tcu_single_file] invalid checksum");
-            send_tcu_negative_ack(packet.header.seq_number);
+            send_tcu_negative_ack(seq, seq);
+            return;
+        }
+
+        // Resent because acknowledgment was lost, saved once
+        if (seq < _recv_next)
+        {
+            spdlog::info("[Node::process_tcu_single_file] duplicate packet {}", seq);
+            send_tcu_positive_ack(seq);
             return;
         }
 
+        _recv_next = seq + 1;
+        finish_message();
+
         File file = File::from_buff(packet.payload);
 
         save_file(file);
 
-        send_tcu_positive_ack(packet.header.seq_number);
+        send_tcu_positive_ack(seq);
     }
     else
     {
@@ -748,29 +1456,27 @@ void Node::process_tcu_single_file(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_more_frag_text(tcu_packet packet)
+void Node::process_tcu_more_frag_text(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_more_frag_text] received tcu text packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
-        if (_received_packets.empty())
-        {
-            // Start timer when first fragment received
-            _receive_start_time_text = std::chrono::steady_clock::now();
-            _seq_num = 1;
-            _last_num = 1;
-            std::cout << "receiving text..." << std::endl;
-        }
+        // Full fragment number, sequence wraps every 2^24 fragments
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
 
         if (!packet.validate_crc())
         {
-            spdlog::warn("[Node::process_tcu_more_frag_text] invalid checksum for packet {}", packet.header.seq_number);
+            spdlog::warn("[Node::process_tcu_more_frag_text] invalid checksum for packet {}", seq);
         }
         else
         {
-            _received_packets[packet.header.seq_number] = packet;
+            if (!_receiving && seq >= _recv_next)
+            {
+                start_message(false);
+            }
+            store_fragment(packet, seq);
         }
     }
     else
@@ -780,41 +1486,51 @@ void Node::process_tcu_more_frag_text(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_last_wind_frag_text(tcu_packet packet)
+void Node::process_tcu_last_wind_frag_text(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_more_frag_text] received tcu last window text packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
+        // Full fragment number, sequence wraps every 2^24 fragments
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
+
         if (!packet.validate_crc())
         {
-            spdlog::warn("[Node::process_tcu_last_wind_frag_text] invalid checksum for packet {}", packet.header.seq_number);
+            spdlog::warn("[Node::process_tcu_last_wind_frag_text] invalid checksum for packet {}", seq);
         }
         else
         {
-            _received_packets[packet.header.seq_number] = packet;
+            if (!_receiving && seq >= _recv_next)
+            {
+                start_message(false);
+            }
+            store_fragment(packet, seq);
         }
 
         // Determine window last packet
-        if (packet.header.seq_number > _last_num)
+        if (seq > _last_num)
         {
-            _last_num = packet.header.seq_number;
+            _last_num = seq;
         }
 
-        // Problem packets
-        for (uint24_t i = _seq_num; i <= _last_num; i++)
+        // Problem packets, everything before first missing one is already consumed
+        if (_recv_next <= _last_num)
         {
-            if (_received_packets.find(i) == _received_packets.end())
-            {
-                spdlog::warn("[Node::process_tcu_last_wind_frag_text] missing packet {}", i);
-                send_tcu_negative_ack(i);
-                return;
-            }
+            spdlog::warn("[Node::process_tcu_last_wind_frag_text] missing packet {}", _recv_next);
+            send_tcu_negative_ack(_recv_next, _last_num);
+            return;
         }
 
         _seq_num = _last_num;
         send_tcu_positive_ack(_last_num);
+
+        // Resent fragment filled last gap after final fragment had arrived
+        if (_final_num > 0)
+        {
+            assemble_text();
+        }
     }
     else
     {
@@ -824,37 +1540,50 @@ void Node::process_tcu_last_wind_frag_text(tcu_packet packet)
 
 }
 
-void Node::process_tcu_last_frag_text(tcu_packet packet)
+void Node::process_tcu_last_frag_text(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_last_frag_text] received tcu last text packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
+        // Full fragment number, sequence wraps every 2^24 fragments
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
+
+        // Copy of final fragment of message already assembled, its acknowledgment was lost
+        if (seq < _recv_next)
+        {
+            spdlog::info("[Node::process_tcu_last_frag_text] duplicate packet {}", seq);
+            send_tcu_positive_ack(_recv_next - 1);
+            return;
+        }
+
         if (!packet.validate_crc())
         {
-            spdlog::warn("[Node::process_tcu_last_frag_text] invalid checksum for packet {}", packet.header.seq_number);
+            spdlog::warn("[Node::process_tcu_last_frag_text] invalid checksum for packet {}", seq);
         }
         else
         {
-            _received_packets[packet.header.seq_number] = packet;
+            if (!_receiving)
+            {
+                start_message(false);
+            }
+            _final_num = seq;
+            store_fragment(packet, seq);
         }
 
         // Determine window last packet
-        if (packet.header.seq_number > _last_num)
+        if (seq > _last_num)
         {
-            _last_num = packet.header.seq_number;
+            _last_num = seq;
         }
 
-        // Problem packets
-        for (uint24_t i = _seq_num; i <= _last_num; i++)
+        // Problem packets, everything before first missing one is already consumed
+        if (_recv_next <= _last_num)
         {
-            if (_received_packets.find(i) == _received_packets.end())
-            {
-                spdlog::warn("[Node::process_tcu_last_frag_text] missing packet {}", i);
-                send_tcu_negative_ack(i);
-                return;
-            }
+            spdlog::warn("[Node::process_tcu_last_frag_text] missing packet {}", _recv_next);
+            send_tcu_negative_ack(_recv_next, _last_num);
+            return;
         }
 
         _seq_num = _last_num;
@@ -868,29 +1597,27 @@ void Node::process_tcu_last_frag_text(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_more_frag_file(tcu_packet packet)
+void Node::process_tcu_more_frag_file(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_more_frag_file] received tcu file packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
-        if (_received_packets.empty())
-        {
-            // Start timer when first fragment received
-            _receive_start_time_file = std::chrono::steady_clock::now();
-            _seq_num = 1;
-            _last_num = 1;
-            std::cout << "receiving file..." << std::endl;
-        }
+        // Full fragment number, sequence wraps every 2^24 fragments
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
 
         if (!packet.validate_crc())
         {
-            spdlog::warn("[Node::process_tcu_more_frag_file] invalid checksum for packet {}", packet.header.seq_number);
+            spdlog::warn("[Node::process_tcu_more_frag_file] invalid checksum for packet {}", seq);
         }
         else
         {
-            _received_packets[packet.header.seq_number] = packet;
+            if (!_receiving && seq >= _recv_next)
+            {
+                start_message(true);
+            }
+            store_fragment(packet, seq);
         }
     }
     else
@@ -900,41 +1627,51 @@ void Node::process_tcu_more_frag_file(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_last_wind_frag_file(tcu_packet packet)
+void Node::process_tcu_last_wind_frag_file(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_last_wind_frag_file] received tcu last window file packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
+        // Full fragment number, sequence wraps every 2^24 fragments
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
+
         if (!packet.validate_crc())
         {
-            spdlog::warn("[Node::process_tcu_last_wind_frag_file] invalid checksum for packet {}", packet.header.seq_number);
+            spdlog::warn("[Node::process_tcu_last_wind_frag_file] invalid checksum for packet {}", seq);
         }
         else
         {
-            _received_packets[packet.header.seq_number] = packet;
+            if (!_receiving && seq >= _recv_next)
+            {
+                start_message(true);
+            }
+            store_fragment(packet, seq);
         }
 
         // Determine window last packet
-        if (packet.header.seq_number > _last_num)
+        if (seq > _last_num)
         {
-            _last_num = packet.header.seq_number;
+            _last_num = seq;
         }
 
-        // Problem packets
-        for (uint24_t i = _seq_num; i <= _last_num; i++)
+        // Problem packets, everything before first missing one is already consumed
+        if (_recv_next <= _last_num)
         {
-            if (_received_packets.find(i) == _received_packets.end())
-            {
-                spdlog::warn("[Node::process_tcu_last_wind_frag_file] missing packet {}", i);
-                send_tcu_negative_ack(i);
-                return;
-            }
+            spdlog::warn("[Node::process_tcu_last_wind_frag_file] missing packet {}", _recv_next);
+            send_tcu_negative_ack(_recv_next, _last_num);
+            return;
         }
 
         _seq_num = _last_num;
         send_tcu_positive_ack(_last_num);
+
+        // Resent fragment filled last gap after final fragment had arrived
+        if (_final_num > 0)
+        {
+            assemble_file();
+        }
     }
     else
     {
@@ -943,37 +1680,50 @@ void Node::process_tcu_last_wind_frag_file(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_last_frag_file(tcu_packet packet)
+void Node::process_tcu_last_frag_file(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_last_frag_file] received tcu last file packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
+        // Full fragment number, sequence wraps every 2^24 fragments
+        uint32_t seq = tcu_seq_unwrap(packet.header.seq_number, _recv_next);
+
+        // Copy of final fragment of message already assembled, its acknowledgment was lost
+        if (seq < _recv_next)
+        {
+            spdlog::info("[Node::process_tcu_last_frag_file] duplicate packet {}", seq);
+            send_tcu_positive_ack(_recv_next - 1);
+            return;
+        }
+
         if (!packet.validate_crc())
         {
-            spdlog::warn("[Node::process_tcu_last_frag_file] invalid checksum for packet {}", packet.header.seq_number);
+            spdlog::warn("[Node::process_tcu_last_frag_file] invalid checksum for packet {}", seq);
         }
         else
         {
-            _received_packets[packet.header.seq_number] = packet;
+            if (!_receiving)
+            {
+                start_message(true);
+            }
+            _final_num = seq;
+            store_fragment(packet, seq);
         }
 
         // Determine window last packet
-        if (packet.header.seq_number > _last_num)
+        if (seq > _last_num)
         {
-            _last_num = packet.header.seq_number;
+            _last_num = seq;
         }
 
-        // Problem packets
-        for (uint24_t i = _seq_num; i <= _last_num; i++)
+        // Problem packets, everything before first missing one is already consumed
+        if (_recv_next <= _last_num)
         {
-            if (_received_packets.find(i) == _received_packets.end())
-            {
-                spdlog::warn("[Node::process_tcu_last_frag_file] missing packet {}", i);
-                send_tcu_negative_ack(i);
-                return;
-            }
+            spdlog::warn("[Node::process_tcu_last_frag_file] missing packet {}", _recv_next);
+            send_tcu_negative_ack(_recv_next, _last_num);
+            return;
         }
 
         _seq_num = _last_num;
@@ -987,99 +1737,257 @@ void Node::process_tcu_last_frag_file(tcu_packet packet)
     }
 }
 
-void Node::process_tcu_negative_ack(tcu_packet packet)
+void Node::process_tcu_negative_ack(const tcu_packet_view& packet)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
         spdlog::info("[Node::process_tcu_negative_ack] received tcu negative acknowledgment packet {}", packet.header.seq_number);
         _pcb.update_last_activity();
 
-        uint24_t nack_seq = packet.header.seq_number;
+        std::lock_guard<std::mutex> lock(_send_mutex);
+
+        // Reported fragment lies between oldest unacknowledged and last sent one
+        uint32_t nack_seq = tcu_seq_unwrap(packet.header.seq_number, _send_base);
+
+        update_peer_window(packet);
 
-        if (_send_packets.size() == 1)
+        // Reordered or left from earlier message, fragments past last released one were never received
+        if (nack_seq < _send_base || nack_seq > _send_next)
         {
-            // Single message
+            spdlog::info("[Node::process_tcu_negative_ack] stale negative acknowledgment {}, unacknowledged [{},{}]", nack_seq, _send_base, _send_next - 1);
+            return;
+        }
+
+        // Every fragment before reported one arrived, acknowledged cumulatively
+        if (nack_seq > _send_base)
+        {
+            acknowledge_until(nack_seq - 1);
+            _send_cv.notify_all();
+        }
+
+        // Receiver misses fragment not released yet, nothing to resend
+        if (nack_seq == _send_next)
+        {
+            spdlog::info("[Node::process_tcu_negative_ack] negative acknowledgment {} past last sent", nack_seq);
+            return;
+        }
+
+        tcu_packet* stored = _send_packets.find(nack_seq);
+        if (stored == nullptr)
+        {
+            spdlog::warn("[Node::process_tcu_negative_ack] unknown packet {}", nack_seq);
+            return;
+        }
 
-            auto it = _send_packets.begin();
-            tcu_packet& single_packet = it->second;
+        tcu_packet& error_packet = *stored;
+        auto now = std::chrono::steady_clock::now();
+
+        if (error_packet.header.flags & TCU_HDR_FLAG_DF)
+        {
+            // Single message
 
             spdlog::info("[Node::process_tcu_negative_ack] single tcu packet");
 
-            single_packet.calculate_crc();
-            send_packet(single_packet.to_buff(), TCU_HDR_LEN + single_packet.header.length, true);
+            if (!claim_resend(nack_seq, now))
+            {
+                spdlog::info("[Node::process_tcu_negative_ack] single packet {} already resent within rto", nack_seq);
+                return;
+            }
+
+            error_packet.calculate_crc();
+            send_packet(error_packet, true);
 
-            spdlog::info("[Node::process_tcu_negative_ack] resent single packet {}", single_packet.header.seq_number);
+            spdlog::info("[Node::process_tcu_negative_ack] resent single packet {}", error_packet.header.seq_number);
         }
         else
         {
-            // Fragmented message
+            // Fragmented message, first missing fragment plus every one marked in bitmap
+            tcu_packet* burst[TCU_NACK_MAX_FRAGMENTS];
+            size_t count = 0;
 
-            auto it = _send_packets.find(nack_seq);
-            if (it != _send_packets.end())
+            // Same hole is reported by every fragment asking for acknowledgment, resent once per rto
+            if (claim_resend(nack_seq, now))
             {
-                tcu_packet& error_packet = it->second;
+                burst[count++] = &error_packet;
+            }
 
-                uint24_t last_window_start = (_total_num > _window_size) ? (_total_num - ((_total_num - uint24_t(1)) % _window_size)) : uint24_t(1);
-                if (nack_seq < last_window_start)
+            const unsigned char* bitmap = packet.payload + sizeof(uint24_t);
+            size_t bitmap_len = packet.header.length > sizeof(uint24_t) ? packet.header.length - sizeof(uint24_t) : 0;
+            bitmap_len = std::min<size_t>(bitmap_len, TCU_NACK_BITMAP_LEN);
+
+            for (size_t bit = 0; bit < bitmap_len * 8; bit++)
+            {
+                if (!(bitmap[bit / 8] & (1u << (bit % 8))))
                 {
-                    // Not in last window
-                    error_packet.header.flags |= TCU_HDR_FLAG_FIN;
-                    spdlog::info("[Node::process_tcu_negative_ack] tcu packet from window");
+                    continue;
                 }
-                else
+
+                uint32_t seq = nack_seq + static_cast<uint32_t>(bit) + 1;
+                tcu_packet* missing = _send_packets.find(seq);
+                if (missing != nullptr && claim_resend(seq, now))
                 {
-                    // In the last window
-                    error_packet.header.flags &= ~TCU_HDR_FLAG_MF;
-                    spdlog::info("[Node::process_tcu_negative_ack] tcu packet from last window", nack_seq);
+                    burst[count++] = missing;
                 }
-                error_packet.calculate_crc();
+            }
+
+            if (count == 0)
+            {
+                spdlog::info("[Node::process_tcu_negative_ack] reported packets from {} already resent within rto", nack_seq);
+                return;
+            }
+
+            // Highest resent fragment asks for acknowledgment, final one does by itself
+            tcu_packet& last = *burst[count - 1];
+            uint32_t first_seq = tcu_seq_unwrap(burst[0]->header.seq_number, nack_seq);
+            uint32_t last_seq = tcu_seq_unwrap(last.header.seq_number, nack_seq);
+            if (last_seq != _send_last && !(last.header.flags & TCU_HDR_FLAG_FIN))
+            {
+                last.header.flags |= TCU_HDR_FLAG_FIN;
+                last.calculate_crc();
+            }
+
+            _congestion->on_loss(nack_seq, _send_next - 1);
 
-                send_packet(error_packet.to_buff(), TCU_HDR_LEN + error_packet.header.length, true);
-                spdlog::info("[Node::process_tcu_negative_ack] recent packet {}", nack_seq);
+            // Whole loss report resent at once, not paced, receiving thread must not sleep
+            if (_host.get_batch_size() > 1 || _socket.load()->uring_enabled())
+            {
+                for (size_t sent = 0; sent < count; sent += SOCKET_MAX_BATCH)
+                {
+                    send_packet_batch(burst + sent, std::min<size_t>(count - sent, SOCKET_MAX_BATCH), true);
+                }
             }
             else
             {
-                spdlog::warn("[Node::process_tcu_negative_ack] unknown packet {}", nack_seq);
+                for (size_t i = 0; i < count; i++)
+                {
+                    send_packet(*burst[i], true);
+                }
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                mark_ack_point(*burst[i]);
+            }
+
+            spdlog::info("[Node::process_tcu_negative_ack] resent {} packets from {} to {}", count, first_seq, last_seq);
+        }
+    }
+    else
+    {
+        spdlog::error("[Node::process_tcu_negative_ack] unexpected phase {}", _pcb.phase);
+        return;
+    }
+}
+
+void Node::process_tcu_positive_ack(const tcu_packet_view& packet)
+{
+    if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
+    {
+        spdlog::info("[Node::process_tcu_positive_ack] received tcu positive acknowledgment packet {}", packet.header.seq_number);
+        _pcb.update_last_activity();
+
+        uint32_t ack_seq;
+
+        {
+            std::lock_guard<std::mutex> lock(_send_mutex);
+
+            // Cumulative acknowledgment never lies before fragment preceding oldest unacknowledged
+            ack_seq = tcu_seq_unwrap(packet.header.seq_number, _send_base);
+
+            // Duplicates still carry fresh window
+            update_peer_window(packet);
+
+            // Cumulative, every fragment up to ack_seq was received
+            if (ack_seq < _send_base)
+            {
+                spdlog::info("[Node::process_tcu_positive_ack] duplicate acknowledgment {}", ack_seq);
+                return;
+            }
+
+            // Reordered or left from earlier message, nothing past last released fragment was received
+            if (ack_seq >= _send_next)
+            {
+                spdlog::warn("[Node::process_tcu_positive_ack] acknowledgment {} beyond last sent {}", ack_seq, _send_next - 1);
                 return;
             }
+
+            acknowledge_until(ack_seq);
+
+            // Set under lock, waiter cannot miss notification
+            _ack_received = true;
+        }
+
+        if (ack_seq >= _send_last)
+        {
+            // Single message or last packet of fragmented message
+            spdlog::info("[Node::process_tcu_positive_ack] all packets successfully sent");
+        }
+        else
+        {
+            // Packet of fragmented message
+            spdlog::info("[Node::process_tcu_positive_ack] slide window to {}", ack_seq + 1);
         }
+
+        _send_cv.notify_all();
     }
     else
     {
-        spdlog::error("[Node::process_tcu_negative_ack] unexpected phase {}", _pcb.phase);
-        return;
+        spdlog::error("[Node::process_tcu_positive_ack] unexpected phase {}", _pcb.phase);
+        return;
+    }
+}
+
+void Node::acknowledge_until(uint32_t ack_seq)
+{
+    // Delivered bytes drive pacing rate, delivered fragments grow congestion window
+    size_t delivered = 0;
+    uint32_t acked = 0;
+    _send_packets.release_until(ack_seq, [&](uint32_t, tcu_packet& packet)
+    {
+        delivered += TCU_HDR_LEN + packet.header.length;
+        acked++;
+    });
+    _pacer.on_delivered(delivered);
+
+    // Round trip sampled only from fragments sent once
+    std::chrono::microseconds rtt{0};
+    auto point = _ack_points.find(ack_seq);
+    if (point != _ack_points.end() && point->second != std::chrono::steady_clock::time_point{})
+    {
+        rtt = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - point->second);
+    }
+    _ack_points.erase(_ack_points.begin(), _ack_points.upper_bound(ack_seq));
+
+    if (rtt.count() > 0)
+    {
+        _pcb.rtt.sample(rtt);
+    }
+
+    if (acked > 0)
+    {
+        _congestion->on_ack(acked, rtt);
     }
+
+    _send_base = ack_seq + 1;
 }
 
-void Node::process_tcu_positive_ack(tcu_packet packet)
+void Node::update_peer_window(const tcu_packet_view& packet)
 {
-    if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
+    // Peers without flow control send empty acknowledgments
+    if (packet.header.length < sizeof(uint24_t) || !packet.validate_crc())
     {
-        spdlog::info("[Node::process_tcu_positive_ack] received tcu positive acknowledgment packet {}", packet.header.seq_number);
-        _pcb.update_last_activity();
+        return;
+    }
 
-        uint24_t ack_seq = packet.header.seq_number;
+    uint24_t window;
+    std::memcpy(&window, packet.payload, sizeof(window));
+    window = ntoh24(window);
 
-        if (ack_seq == _total_num)
-        {
-            // Single message or last packet of fragmented message
-            _seq_num += _window_size;
-            spdlog::info("[Node::process_tcu_positive_ack] all packets successfully sent");
-            _ack_received = true;
-        }
-        else
-        {
-            // Packet of fragmented message
-            _seq_num += _window_size;
-            spdlog::info("[Node::process_tcu_positive_ack] move to next window starting {}", _seq_num);
-            _ack_received = true;
-        }
-    }
-    else
+    if (static_cast<uint32_t>(window) != _peer_window)
     {
-        spdlog::error("[Node::process_tcu_positive_ack] unexpected phase {}", _pcb.phase);
-        return;
+        spdlog::info("[Node::update_peer_window] receiver window {}", window);
     }
+    _peer_window = std::max<uint32_t>(window, 1);
 }
 
 void Node::send_tcu_conn_req()
@@ -1101,11 +2009,21 @@ void Node::send_tcu_conn_req()
         packet.header.seq_number = 0;
         packet.calculate_crc();
 
-        _pcb.new_phase(TCU_PHASE_CONNECT);
+        new_phase(TCU_PHASE_CONNECT);
+        _pcb.rtt.reset();
+        reset_path_mtu();
 
         _ack_received = false;
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
-        wait_for_conf_ack();
+        _conf_retransmitted = false;
+        _conf_sent = std::chrono::steady_clock::now();
+        send_packet(packet, true);
+        wait_for_conf_ack(packet);
+
+        // Fragment size settled once, before any data is sent
+        if (_path_probing && _pcb.phase == TCU_PHASE_NETWORK)
+        {
+            discover_path_mtu();
+        }
     }
     else if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
@@ -1131,9 +2049,9 @@ void Node::send_tcu_conn_ack()
         packet.header.seq_number = 0;
         packet.calculate_crc();
 
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
+        send_packet(packet, true);
 
-        _pcb.new_phase(TCU_PHASE_NETWORK);
+        new_phase(TCU_PHASE_NETWORK);
     }
     else
     {
@@ -1154,11 +2072,13 @@ void Node::send_tcu_disconn_req()
         packet.header.seq_number = 0;
         packet.calculate_crc();
 
-        _pcb.new_phase(TCU_PHASE_DISCONNECT);
+        new_phase(TCU_PHASE_DISCONNECT);
 
         _ack_received = false;
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
-        wait_for_conf_ack();
+        _conf_retransmitted = false;
+        _conf_sent = std::chrono::steady_clock::now();
+        send_packet(packet, true);
+        wait_for_conf_ack(packet);
     }
     else if (_pcb.phase <= TCU_PHASE_INITIALIZE)
     {
@@ -1185,9 +2105,9 @@ void Node::send_tcu_disconn_ack()
         packet.header.seq_number = 0;
         packet.calculate_crc();
 
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
+        send_packet(packet, true);
 
-        _pcb.new_phase(TCU_PHASE_HOLDOFF);
+        new_phase(TCU_PHASE_HOLDOFF);
     }
     else
     {
@@ -1205,7 +2125,32 @@ void Node::send_keep_alive_req()
     packet.header.seq_number = 0;
     packet.calculate_crc();
 
-    send_packet(packet.to_buff(), TCU_HDR_LEN, true);
+    send_packet(packet, true);
+}
+
+void Node::send_probe_ack(uint16_t length)
+{
+    if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
+    {
+        spdlog::info("[Node::send_probe_ack] sending tcu path probe acknowledgment {}", length);
+
+        // KA + ACK, probed length
+        tcu_packet packet{};
+        packet.header.flags = TCU_HDR_FLAG_KA | TCU_HDR_FLAG_ACK;
+        packet.header.length = sizeof(length);
+        packet.header.seq_number = 0;
+
+        uint16_t length_net = htons(length);
+        std::memcpy(packet.alloc_payload(sizeof(length_net)), &length_net, sizeof(length_net));
+        packet.calculate_crc();
+
+        send_packet(packet, true);
+    }
+    else
+    {
+        spdlog::error("[Node::send_probe_ack] unexpected phase {}", _pcb.phase);
+        return;
+    }
 }
 
 void Node::send_keep_alive_ack()
@@ -1221,7 +2166,7 @@ void Node::send_keep_alive_ack()
         packet.header.seq_number = 0;
         packet.calculate_crc();
 
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
+        send_packet(packet, true);
     }
     else
     {
@@ -1231,7 +2176,7 @@ void Node::send_keep_alive_ack()
 
 }
 
-void Node::send_window()
+void Node::send_window(uint32_t first, uint32_t last)
 {
     if (_dist(_gen) < _window_loss_rate)
     {
@@ -1239,20 +2184,303 @@ void Node::send_window()
         return;
     }
 
-    spdlog::info("[Node::send_window] sending window range [{},{}]", _seq_num, std::min(_seq_num + _window_size - uint24_t(1), _total_num));
+    spdlog::info("[Node::send_window] sending window range [{},{}]", first, last);
+
+    // Send all fragments for range still waiting in retransmission buffer
+    const tcu_packet* batch[SOCKET_MAX_BATCH];
+    size_t batch_limit = (_host.offload_enabled() || _socket.load()->uring_enabled() || _host.get_transmitter()) ? SOCKET_MAX_BATCH : std::max<size_t>(_host.get_batch_size(), 1);
+
+    uint32_t seq = first;
+    while (seq <= last)
+    {
+        // Released at paced rate, batch counts as one burst, sleeping outside lock keeps acks flowing
+        size_t expected = std::min<size_t>(batch_limit, last - seq + 1) * (TCU_HDR_LEN + _max_frag_size);
+        _pacer.wait(expected);
+
+        {
+            // Acknowledgments release fragments concurrently, buffer is locked per batch
+            std::lock_guard<std::mutex> lock(_send_mutex);
+
+            size_t pending = 0;
+            for (; seq <= last && pending < batch_limit; seq++)
+            {
+                tcu_packet* stored = _send_packets.find(seq);
+                if (stored != nullptr)
+                {
+                    spdlog::info("[Node::send_window] sending tcp fragment {}", seq);
+                    batch[pending++] = stored;
+                }
+            }
+
+            if (pending == 0)
+            {
+                continue;
+            }
+
+            // Batched or segmented mode, one syscall per batch
+            if (batch_limit <= 1)
+            {
+                send_packet(*batch[0], false);
+            }
+            else
+            {
+                send_window_batch(batch, pending);
+            }
+
+            for (size_t i = 0; i < pending; i++)
+            {
+                mark_ack_point(*batch[i]);
+            }
+        }
+    }
+}
+
+void Node::mark_ack_point(const tcu_packet& packet)
+{
+    if (!(packet.header.flags & TCU_HDR_FLAG_FIN))
+    {
+        return;
+    }
+
+    // Karn, acknowledgment of resent fragment is ambiguous and gives no round trip sample
+    auto [it, inserted] = _ack_points.try_emplace(tcu_seq_unwrap(packet.header.seq_number, _send_base), std::chrono::steady_clock::now());
+    if (!inserted)
+    {
+        it->second = std::chrono::steady_clock::time_point{};
+    }
+}
+
+bool Node::claim_resend(uint32_t seq, std::chrono::steady_clock::time_point now)
+{
+    // Slot per retransmission buffer entry, allocated with first resend
+    if (_resent.empty())
+    {
+        _resent.resize(_send_packets.capacity());
+    }
+
+    resend_mark& mark = _resent[seq & (_resent.size() - 1)];
+    if (mark.seq == seq && now - mark.at < _pcb.rtt.rto())
+    {
+        return false;
+    }
+
+    mark.seq = seq;
+    mark.at = now;
+    return true;
+}
+
+void Node::send_window_batch(const tcu_packet* const* packets, size_t count)
+{
+    if (_host.offload_enabled())
+    {
+        send_packet_segmented(packets, count);
+    }
+    else
+    {
+        send_packet_batch(packets, count, false);
+    }
+}
+
+tcu_packet Node::build_fragment(uint32_t seq) const
+{
+    // Position within message, numbering runs across messages
+    uint32_t index = seq - _send_first;
+    size_t offset = static_cast<size_t>(index) * _max_frag_size;
+    size_t fragment_size = std::min(_max_frag_size, _send_length - offset);
+
+    tcu_packet packet{};
+    packet.header.seq_number = seq;
+    packet.header.length = static_cast<uint16_t>(fragment_size);
+    packet.alloc_payload(fragment_size);
+
+    // Fragment may span file header, data and message checksum
+    size_t prefix = _send_prefix.size();
+    size_t data_end = _send_length - TCU_MESSAGE_CRC_LEN;
+    size_t end = offset + fragment_size;
+    unsigned char* out = packet.payload;
+
+    if (offset < prefix)
+    {
+        size_t part = std::min(prefix, end) - offset;
+        std::memcpy(out, _send_prefix.data() + offset, part);
+        out += part;
+        offset += part;
+    }
+    if (offset < data_end && offset < end)
+    {
+        size_t part = std::min(data_end, end) - offset;
+        std::memcpy(out, _send_data + (offset - prefix), part);
+        out += part;
+        offset += part;
+    }
+    if (offset < end)
+    {
+        std::memcpy(out, _send_trailer + (offset - data_end), end - offset);
+    }
+
+    if (seq == _send_last)
+    {
+        packet.header.flags = _send_flags;
+    }
+    else if ((index + 1) % _window_size == 0)
+    {
+        packet.header.flags = TCU_HDR_FLAG_FIN | TCU_HDR_FLAG_MF | _send_flags;
+    }
+    else
+    {
+        packet.header.flags = TCU_HDR_FLAG_MF | _send_flags;
+    }
+
+    packet.calculate_crc();
+
+    return packet;
+}
+
+void Node::send_fragments()
+{
+    std::unique_lock<std::mutex> lock(_send_mutex);
+
+    // Message continues numbering of connection
+    _send_packets.reset(_send_next);
+    _send_base = _send_next;
+    _send_first = _send_next;
+    _send_last = _send_first + _total_num - 1;
+
+    _pacer.start(TCU_HDR_LEN + _max_frag_size);
+
+    _congestion->reset();
+    _ack_points.clear();
+    _peer_window = TCU_RETRANSMIT_BUFFER_LEN;       // Until receiver advertises its own
+
+    auto last_progress = std::chrono::steady_clock::now();
 
-    // Send all fragments for the current window
-    for (uint24_t seq = _seq_num; seq < _seq_num + _window_size && seq <= _total_num; seq++)
+    while (_send_base <= _send_last && _pcb.phase == TCU_PHASE_NETWORK)
     {
-        auto it = _send_packets.find(seq);
-        if (it != _send_packets.end())
+        // Several windows in flight, bounded by retransmission buffer, congestion and receiver windows
+        uint32_t in_flight = std::min<uint32_t>({static_cast<uint32_t>(_window_size) * TCU_WINDOWS_IN_FLIGHT, TCU_RETRANSMIT_BUFFER_LEN, _congestion->get_window(), _peer_window});
+
+        // Release new fragments as soon as oldest ones are acknowledged
+        // Differences of fragment numbers, sums near end of 32-bit range would wrap
+        if (_send_next <= _send_last && _send_next - _send_base < in_flight)
+        {
+            uint32_t first = _send_next;
+            uint32_t last = _send_base + std::min(in_flight - 1, _send_last - _send_base);
+
+            release_sent_file();
+
+            for (uint32_t seq = first; seq <= last; seq++)
+            {
+                _send_packets.insert(seq, build_fragment(seq));
+            }
+            _send_next = last + 1;
+
+            // Congestion window edge asks for ack, otherwise sender waits for next window boundary
+            tcu_packet& edge = *_send_packets.find(last);
+            if (last != _send_last && !(edge.header.flags & TCU_HDR_FLAG_FIN))
+            {
+                edge.header.flags |= TCU_HDR_FLAG_FIN;
+                edge.calculate_crc();
+            }
+
+            lock.unlock();
+            send_window(first, last);
+            lock.lock();
+            continue;
+        }
+
+        uint32_t base = _send_base;
+        if (_send_cv.wait_for(lock, _pcb.rtt.rto(), [&]() { return _send_base != base || _pcb.phase != TCU_PHASE_NETWORK; }))
+        {
+            last_progress = std::chrono::steady_clock::now();
+            continue;
+        }
+
+        if (std::chrono::steady_clock::now() - last_progress >= std::chrono::seconds(TCU_RECEIVE_TIMEOUT_INTERVAL))
+        {
+            _send_packets.reset(_send_next);
+            lock.unlock();
+
+            spdlog::error("[Node::send_fragments] no tcu receive acknowledgment, closing connection");
+            new_phase(TCU_PHASE_HOLDOFF);
+            stop_keep_alive();
+            std::cout << "destination node down, connection closed" << std::endl;
+            return;
+        }
+
+        _pcb.rtt.backoff();
+        _congestion->on_timeout(_send_next - 1);
+
+        // Oldest window lost with its acknowledgment point, resend it asking for ack at its end
+        uint32_t first = _send_base;
+        uint32_t last = _send_next - 1;
+        if (_send_next - _send_base > _window_size)
+        {
+            last = _send_base + _window_size - 1;
+        }
+
+        tcu_packet* edge = _send_packets.find(last);
+        if (edge != nullptr && last != _send_last && !(edge->header.flags & TCU_HDR_FLAG_FIN))
         {
-            spdlog::info("[Node::send_window] sending tcp fragment {}", it->first);
+            edge->header.flags |= TCU_HDR_FLAG_FIN;
+            edge->calculate_crc();
+        }
 
-            tcu_packet& packet = it->second;
-            send_packet(packet.to_buff(), TCU_HDR_LEN + packet.header.length, false);
-            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        // Loss reports arriving meanwhile do not resend same fragments again
+        auto now = std::chrono::steady_clock::now();
+        for (uint32_t seq = first; seq <= last; seq++)
+        {
+            claim_resend(seq, now);
         }
+
+        spdlog::info("[Node::send_fragments] no tcu receive acknowledgment, resending window [{},{}] rto {} us", first, last, _pcb.rtt.rto().count());
+
+        lock.unlock();
+        send_window(first, last);
+        lock.lock();
+    }
+
+    _send_packets.reset(_send_next);
+    _ack_points.clear();
+    _send_data = nullptr;
+    _send_source = nullptr;
+}
+
+bool Node::fragments_left(uint64_t count)
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+
+    // Numbers are 32 bits and never reused on connection
+    uint64_t left = TCU_MAX_FRAGMENTS - (_send_next - 1);
+    if (count > left)
+    {
+        spdlog::error("[Node::fragments_left] message needs {} fragments, connection has {} numbers left", count, left);
+        return false;
+    }
+    return true;
+}
+
+void Node::set_message_crc(uint16_t crc)
+{
+    // Big endian, receiver running checksum over message and trailer ends at zero
+    _send_trailer[0] = static_cast<unsigned char>(crc >> 8);
+    _send_trailer[1] = static_cast<unsigned char>(crc & 0xFF);
+}
+
+void Node::release_sent_file()
+{
+    if (_send_source == nullptr)
+    {
+        return;
+    }
+
+    // Acknowledged fragments are never read again, their pages need not stay resident
+    size_t acked = std::min(static_cast<size_t>(_send_base - _send_first) * _max_frag_size, _send_length - TCU_MESSAGE_CRC_LEN);
+    acked = acked > _send_prefix.size() ? acked - _send_prefix.size() : 0;
+
+    if (acked - _send_released >= FILE_RELEASE_CHUNK)
+    {
+        _send_source->drop(_send_released, acked - _send_released);
+        _send_released = acked;
     }
 }
 
@@ -1260,32 +2488,49 @@ void Node::send_text(const std::string& message)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
-
-        _send_packets.clear();
-        _seq_num = 1;
+        // Accepting side probes before its first message
+        if (_path_probing && !_path_probed)
+        {
+            discover_path_mtu();
+        }
 
         size_t message_length = message.size();
         size_t max_payload_size = _max_frag_size;
 
+        if (!fragments_left(std::max<size_t>((message_length + TCU_MESSAGE_CRC_LEN + max_payload_size - 1) / max_payload_size, 1)))
+        {
+            std::cout << "text too large for fragment size" << std::endl;
+            return;
+        }
+
         if (message_length <= max_payload_size)
         {
             // DF
             tcu_packet packet{};
             packet.header.flags = TCU_HDR_FLAG_DF;
             packet.header.length = static_cast<uint16_t>(message_length);
-            packet.header.seq_number = 1;
-            packet.payload = new unsigned char[message_length];
+            packet.alloc_payload(message_length);
             std::memcpy(packet.payload, message.data(), message_length);
 
-            packet.calculate_crc();
-
-            _send_packets[packet.header.seq_number] = packet;
-
             spdlog::info("[Node::send_file] sent tcu single text size {}", message_length);
             std::cout << "sending text..." << std::endl;
 
             _ack_received = false;
-            send_packet(packet.to_buff(), TCU_HDR_LEN + message_length, false);
+            {
+                std::lock_guard<std::mutex> lock(_send_mutex);
+
+                // Single message takes next fragment number of connection
+                uint32_t seq = _send_next++;
+                _send_packets.reset(seq);
+                _send_base = seq;
+                _send_last = seq;
+
+                packet.header.seq_number = seq;
+                packet.calculate_crc();
+
+                tcu_packet& stored = _send_packets.insert(seq, std::move(packet));
+                send_packet(stored, false);
+            }
             wait_for_recv_ack();
 
             // Checking success using phase
@@ -1297,53 +2542,27 @@ void Node::send_text(const std::string& message)
         }
         else
         {
-            // Fragmented
-            _total_num = (message_length + max_payload_size - 1) / max_payload_size;
+            // Fragmented, checksum closes message
+            crc16_ctx message_crc;
+            message_crc.update(message.data(), message_length);
+            set_message_crc(message_crc.final());
+
+            _total_num = (message_length + TCU_MESSAGE_CRC_LEN + max_payload_size - 1) / max_payload_size;
             if (_dynamic_window)
             {
                 dynamic_window_size();
             }
 
-            size_t offset = 0;
-            for (uint24_t seq = 1; seq <= _total_num; seq++)
-            {
-                size_t fragment_size = std::min(max_payload_size, message_length - offset);
-
-                tcu_packet packet{};
-                packet.header.seq_number = seq;
-                packet.header.length = static_cast<uint16_t>(fragment_size);
-                packet.payload = new unsigned char[fragment_size];
-                std::memcpy(packet.payload, message.data() + offset, fragment_size);
-
-                if (seq == _total_num)
-                {
-                    packet.header.flags = TCU_HDR_NO_FLAG;
-                }
-                else if (seq % _window_size == 0)
-                {
-                    packet.header.flags = TCU_HDR_FLAG_FIN | TCU_HDR_FLAG_MF;
-                }
-                else
-                {
-                    packet.header.flags = TCU_HDR_FLAG_MF;
-                }
-
-                packet.calculate_crc();
-
-                _send_packets[seq] = packet;
+            // Fragments are built when they enter window
+            _send_prefix.clear();
+            _send_data = reinterpret_cast<const unsigned char*>(message.data());
+            _send_length = message_length + TCU_MESSAGE_CRC_LEN;
+            _send_flags = TCU_HDR_NO_FLAG;
 
-                offset += fragment_size;
-            }
-
-            spdlog::info("[Node::send_text] sent tcu fragmented text size {} fragments {} fragment size {}", message_length, _total_num, max_payload_size);
+            spdlog::info("[Node::send_text] sent tcu fragmented text size {} fragments {} fragment size {} checksum {:#06x}", message_length, _total_num, max_payload_size, message_crc.final());
             std::cout << "sending text..." << std::endl;
 
-            while (_seq_num <= _total_num && _pcb.phase == TCU_PHASE_NETWORK)
-            {
-                _ack_received = false;
-                send_window();
-                wait_for_recv_ack();
-            }
+            send_fragments();
 
             if (_pcb.phase == TCU_PHASE_NETWORK)
             {
@@ -1363,59 +2582,66 @@ void Node::send_file(const std::string& file_path)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
-        _send_packets.clear();
-        _seq_num = 1;
-
-        std::ifstream file_stream(file_path, std::ios::binary | std::ios::ate);
-        if (!file_stream)
+        if (_path_probing && !_path_probed)
         {
-            std::cout << "error file opening" << std::endl;
-            return;
+            discover_path_mtu();
         }
 
-        // File size
-        std::streamsize file_size = file_stream.tellg();
-        file_stream.seekg(0, std::ios::beg);
-
-        // File data
-        std::vector<unsigned char> file_data(static_cast<size_t>(file_size));
-        if (!file_stream.read(reinterpret_cast<char*>(file_data.data()), file_size))
+        // File is read straight from page cache, never copied whole
+        std::unique_ptr<MappedFile> source = MappedFile::open(file_path);
+        if (!source)
         {
-            std::cout << "error file reading" << std::endl;
+            std::cout << "error file opening" << std::endl;
             return;
         }
 
         // File name
         std::string file_name = file_path.substr(file_path.find_last_of("/\\") + 1);
 
-        // Creating file object
-        File file(file_name.c_str(), file_data.data(), static_cast<uint32_t>(file_size));
-
-        // File to buff
-        unsigned char* file_buffer = file.to_buff();
-        size_t total_size = sizeof(file.get_header().name_length) + file.get_header().name_length + sizeof(file.get_header().file_size) + file.get_size();
+        // Header goes ahead of mapped data
+        std::vector<unsigned char> prefix = File::header_to_buff(file_name.c_str(), source->get_size());
+        size_t total_size = prefix.size() + source->get_size();
 
         size_t max_payload_size = _max_frag_size;
 
+        if (!fragments_left((total_size + TCU_MESSAGE_CRC_LEN + max_payload_size - 1) / max_payload_size))
+        {
+            std::cout << "file too large for fragment size" << std::endl;
+            return;
+        }
+
         if (total_size <= max_payload_size)
         {
             // DF + FL
             tcu_packet packet{};
             packet.header.flags = TCU_HDR_FLAG_DF | TCU_HDR_FLAG_FL;
             packet.header.length = static_cast<uint16_t>(total_size);
-            packet.header.seq_number = 1;
-            packet.payload = new unsigned char[total_size];
-            std::memcpy(packet.payload, file_buffer, total_size);
-
-            packet.calculate_crc();
-
-            _send_packets[packet.header.seq_number] = packet;
+            packet.alloc_payload(total_size);
+            std::memcpy(packet.payload, prefix.data(), prefix.size());
+            if (source->get_size() > 0)
+            {
+                std::memcpy(packet.payload + prefix.size(), source->get_data(), source->get_size());
+            }
 
             spdlog::info("[Node::send_file] sent tcu single file name {} size {}", file_name, total_size);
             std::cout << "sending file..." << std::endl;
 
             _ack_received = false;
-            send_packet(packet.to_buff(), TCU_HDR_LEN + total_size, false);
+            {
+                std::lock_guard<std::mutex> lock(_send_mutex);
+
+                // Single message takes next fragment number of connection
+                uint32_t seq = _send_next++;
+                _send_packets.reset(seq);
+                _send_base = seq;
+                _send_last = seq;
+
+                packet.header.seq_number = seq;
+                packet.calculate_crc();
+
+                tcu_packet& stored = _send_packets.insert(seq, std::move(packet));
+                send_packet(stored, false);
+            }
             wait_for_recv_ack();
 
             // Checking success using phase
@@ -1428,52 +2654,37 @@ void Node::send_file(const std::string& file_path)
         else
         {
             // Fragmented
-            _total_num = (total_size + max_payload_size - 1) / max_payload_size;
+            _total_num = (total_size + TCU_MESSAGE_CRC_LEN + max_payload_size - 1) / max_payload_size;
             if (_dynamic_window)
             {
                 dynamic_window_size();
             }
 
-            size_t offset = 0;
-            for (uint24_t seq = 1; seq <= _total_num; seq++) {
-                size_t fragment_size = std::min(max_payload_size, total_size - offset);
-
-                tcu_packet packet{};
-                packet.header.seq_number = seq;
-                packet.header.length = static_cast<uint16_t>(fragment_size);
-                packet.payload = new unsigned char[fragment_size];
-                std::memcpy(packet.payload, file_buffer + offset, fragment_size);
-
-                if (seq == _total_num)
-                {
-                    packet.header.flags = TCU_HDR_FLAG_FL;
-                }
-                else if (seq % _window_size == 0)
-                {
-                    packet.header.flags = TCU_HDR_FLAG_FIN | TCU_HDR_FLAG_MF | TCU_HDR_FLAG_FL;
-                }
-                else
-                {
-                    packet.header.flags = TCU_HDR_FLAG_MF | TCU_HDR_FLAG_FL;
-                }
-
-                packet.calculate_crc();
+            // Fragments are built when they enter window
+            _send_prefix = std::move(prefix);
+            _send_data = source->get_data();
+            _send_length = total_size + TCU_MESSAGE_CRC_LEN;
+            _send_flags = TCU_HDR_FLAG_FL;
 
-                _send_packets[seq] = packet;
+            _send_source = source.get();
+            _send_released = 0;
 
-                offset += fragment_size;
+            // Checksum pass reads file once, pages leave memory behind it
+            crc16_ctx message_crc;
+            message_crc.update(_send_prefix.data(), _send_prefix.size());
+            for (size_t offset = 0; offset < source->get_size(); offset += FILE_RELEASE_CHUNK)
+            {
+                size_t chunk = std::min<size_t>(FILE_RELEASE_CHUNK, source->get_size() - offset);
+                message_crc.update(source->get_data() + offset, chunk);
+                source->drop(offset, chunk);
             }
+            set_message_crc(message_crc.final());
 
-            spdlog::info("[Node::send_file] sent tcu fragmented file name {} size {} fragments {} fragment size {}", file_name, total_size, _total_num, max_payload_size);
+            spdlog::info("[Node::send_file] sent tcu fragmented file name {} size {} fragments {} fragment size {} checksum {:#06x}", file_name, total_size, _total_num, max_payload_size, message_crc.final());
             std::cout << "sending file..." << std::endl;
 
             // Sending file
-            while (_seq_num <= _total_num && _pcb.phase == TCU_PHASE_NETWORK)
-            {
-                _ack_received = false;
-                send_window();
-                wait_for_recv_ack();
-            }
+            send_fragments();
 
             // Checking success using phase
             if (_pcb.phase == TCU_PHASE_NETWORK)
@@ -1482,8 +2693,6 @@ void Node::send_file(const std::string& file_path)
                 std::cout << "complete" << std::endl;
             }
         }
-
-        delete[] file_buffer;
     }
     else
     {
@@ -1492,19 +2701,40 @@ void Node::send_file(const std::string& file_path)
     }
 }
 
-void Node::send_tcu_negative_ack(uint24_t seq_number)
+void Node::send_tcu_negative_ack(uint32_t seq_number, uint32_t last_number)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
-        spdlog::info("[Node::send_tcu_negative_ack] send tcu negative acknowledgment for fragment {}", seq_number);
-
         tcu_packet packet{};
         packet.header.flags = TCU_HDR_FLAG_NACK;
-        packet.header.length = 0;
         packet.header.seq_number = seq_number;
+
+        // Receive window, then bitmap of missing fragments after seq_number
+        unsigned char* payload = packet.alloc_payload(sizeof(uint24_t) + TCU_NACK_BITMAP_LEN);
+
+        uint24_t window = hton24(advertised_window());
+        std::memcpy(payload, &window, sizeof(window));
+
+        unsigned char* bitmap = payload + sizeof(window);
+        std::memset(bitmap, 0, TCU_NACK_BITMAP_LEN);
+
+        size_t bitmap_len = 0;
+        size_t missing = 1;
+        uint32_t last = std::min<uint32_t>(last_number, seq_number + TCU_NACK_BITMAP_LEN * 8);
+        _received_packets.for_each_missing(seq_number + 1, last, [&](uint32_t seq)
+        {
+            size_t bit = seq - seq_number - 1;
+            bitmap[bit / 8] |= static_cast<unsigned char>(1u << (bit % 8));
+            bitmap_len = bit / 8 + 1;
+            missing++;
+        });
+
+        packet.header.length = static_cast<uint16_t>(sizeof(window) + bitmap_len);
         packet.calculate_crc();
 
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
+        spdlog::info("[Node::send_tcu_negative_ack] send tcu negative acknowledgment for fragment {}, {} missing up to {}", seq_number, missing, last_number);
+
+        send_packet(packet, true);
     }
     else
     {
@@ -1513,7 +2743,7 @@ void Node::send_tcu_negative_ack(uint24_t seq_number)
     }
 }
 
-void Node::send_tcu_positive_ack(uint24_t seq_number)
+void Node::send_tcu_positive_ack(uint32_t seq_number)
 {
     if (_pcb.phase >= TCU_PHASE_CONNECT && _pcb.phase <= TCU_PHASE_NETWORK)
     {
@@ -1521,11 +2751,17 @@ void Node::send_tcu_positive_ack(uint24_t seq_number)
 
         tcu_packet packet{};
         packet.header.flags = TCU_HDR_FLAG_ACK;
-        packet.header.length = 0;
         packet.header.seq_number = seq_number;
+
+        // Receive window as payload
+        uint24_t window = hton24(advertised_window());
+        packet.header.length = sizeof(window);
+        packet.alloc_payload(sizeof(window));
+        std::memcpy(packet.payload, &window, sizeof(window));
+
         packet.calculate_crc();
 
-        send_packet(packet.to_buff(), TCU_HDR_LEN, true);
+        send_packet(packet, true);
     }
     else
     {
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <cstring>
@@ -15,6 +16,7 @@
 #include <arpa/inet.h>
 #include <fcntl.h>
 #include <condition_variable>
+#include <mutex>
 #include <spdlog/spdlog.h>
 #include <fstream>
 #include <sys/stat.h>
@@ -25,17 +27,34 @@
 
 #include "../protocols/tcu.h"
 #include "../types/uint24_t.h"
+#include "../types/seq_ring.h"
+#include "../types/spsc_ring.h"
 #include "file.h"
+#include "file_writer.h"
 #include "socket.h"
+#include "reactor.h"
+#include "pacer.h"
+#include "congestion.h"
+#include "executor.h"
+#include "transmitter.h"
+#include "../tools/stats.h"
 
+#define NODE_INBOX_LEN          16384   // Datagrams waiting for executor per peer, newer ones are dropped
+#define NODE_INBOX_BATCH        64      // Datagrams worker takes from inbox at once
+
+class Host;
+
+/* One peer, socket and event loop are shared with other peers of same host shard */
 class Node {
 public:
-    Node();
+    Node(Host& host, Socket& socket, Reactor& reactor);
     ~Node();
 
     /* Getters */
     inline tcu_pcb &get_pcb(){ return _pcb; };
     inline std::string get_path(){ return _file_path; };
+    inline Pacer &get_pacer(){ return _pacer; };
+    std::string get_congestion_report();
 
     /* Setters */
     void set_port(uint16_t port);
@@ -47,15 +66,26 @@ public:
     void set_error_rate(double rate);
     void set_packet_loss_rate(double rate);
     void set_window_loss_rate(double rate);
+    void set_receive_buffer(size_t size);
+    void set_rate_ceiling(uint64_t bytes_per_sec);
+    void set_pacing_burst(size_t packets);
+    void set_congestion_control(const std::string& name);
+    void set_direct_file(bool enabled);
+    void set_path_probing(bool enabled);
+
+    /* Protocol options of other peer, used for accepted connections */
+    void copy_settings(Node& other);
 
     /* Abstract methods */
-    void send_packet(unsigned char* buff, size_t length, bool service);     // Function to send packet
-    void receive_packet();                                                  // Function to receive packet
+    void send_packet(const tcu_packet& packet, bool service);               // Function to send packet
+    void send_packet_batch(const tcu_packet* const* packets, size_t count, bool service);   // Function to send packets with one syscall
+    void send_packet_segmented(const tcu_packet* const* packets, size_t count);             // Function to send packets with UDP GSO
 
     /* Concrete methods */
     void send_text(const std::string& message);
     void send_file(const std::string& path);
-    void send_window();
+    void send_window(uint32_t first, uint32_t last);
+    void send_window_batch(const tcu_packet* const* packets, size_t count);
 
     /* Process information methods */
     void assemble_text();
@@ -63,42 +93,50 @@ public:
     void save_file(const File& file);
 
     /* Thread methods */
-    void start_receiving();
-    void stop_receiving();
-
     void start_keep_alive();
     void stop_keep_alive();
 
     /* Waiting methods */
-    void wait_for_conf_ack();
+    void wait_for_conf_ack(const tcu_packet& request);         // Resends request on retransmission timeout
     void wait_for_recv_ack();
 
     /* FSM methods */
-    void fsm_process(unsigned char* buff, size_t length);
+    void fsm_process(const unsigned char* buff, size_t length);
+    void enqueue(const unsigned char* buff, size_t length, Executor& executor);     // Copies datagram, processed later in order
+    [[nodiscard]] size_t get_inbox_peak() const { return _inbox_peak.load(std::memory_order_relaxed); }
+    [[nodiscard]] bool inbox_idle() const { return !_inbox_scheduled.load(std::memory_order_acquire); }
+
+    /* Closed peer left connection table, datagrams from its address look for new one */
+    void mark_released() { _released.store(true, std::memory_order_release); }
+    [[nodiscard]] bool is_released() const { return _released.load(std::memory_order_acquire); }
+
+    /* Shard kernel steers peer to, called by its receiving thread */
+    void move_to(Socket& socket, Reactor& reactor);
+    [[nodiscard]] bool homed_on(const Reactor& reactor);
 
     /* Processing */
-    void process_tcu_conn_req(tcu_packet packet);
-    void process_tcu_conn_ack(tcu_packet packet);
+    void process_tcu_conn_req(const tcu_packet_view& packet);
+    void process_tcu_conn_ack(const tcu_packet_view& packet);
 
-    void process_tcu_disconn_req(tcu_packet packet);
-    void process_tcu_disconn_ack(tcu_packet packet);
+    void process_tcu_disconn_req(const tcu_packet_view& packet);
+    void process_tcu_disconn_ack(const tcu_packet_view& packet);
 
-    void process_tcu_ka_req(tcu_packet packet);
-    void process_tcu_ka_ack(tcu_packet packet);
+    void process_tcu_ka_req(const tcu_packet_view& packet);
+    void process_tcu_ka_ack(const tcu_packet_view& packet);
 
-    void process_tcu_single_text(tcu_packet packet);
-    void process_tcu_single_file(tcu_packet packet);
+    void process_tcu_single_text(const tcu_packet_view& packet);
+    void process_tcu_single_file(const tcu_packet_view& packet);
 
-    void process_tcu_more_frag_text(tcu_packet packet);
-    void process_tcu_last_wind_frag_text(tcu_packet packet);
-    void process_tcu_last_frag_text(tcu_packet packet);
+    void process_tcu_more_frag_text(const tcu_packet_view& packet);
+    void process_tcu_last_wind_frag_text(const tcu_packet_view& packet);
+    void process_tcu_last_frag_text(const tcu_packet_view& packet);
 
-    void process_tcu_more_frag_file(tcu_packet packet);
-    void process_tcu_last_wind_frag_file(tcu_packet packet);
-    void process_tcu_last_frag_file(tcu_packet packet);
+    void process_tcu_more_frag_file(const tcu_packet_view& packet);
+    void process_tcu_last_wind_frag_file(const tcu_packet_view& packet);
+    void process_tcu_last_frag_file(const tcu_packet_view& packet);
 
-    void process_tcu_positive_ack(tcu_packet packet);
-    void process_tcu_negative_ack(tcu_packet packet);
+    void process_tcu_positive_ack(const tcu_packet_view& packet);
+    void process_tcu_negative_ack(const tcu_packet_view& packet);
 
     /* Sending */
     void send_tcu_conn_req();
@@ -109,49 +147,146 @@ public:
 
     void send_keep_alive_req();
     void send_keep_alive_ack();
+    void send_probe_ack(uint16_t length);
 
-    void send_tcu_negative_ack(uint24_t seq_number);
-    void send_tcu_positive_ack(uint24_t seq_number);
+    /* Path MTU discovery, fragment size becomes largest payload path carries */
+    void discover_path_mtu();
+
+    void send_tcu_negative_ack(uint32_t seq_number, uint32_t last_number);   // Reports every gap up to last_number
+    void send_tcu_positive_ack(uint32_t seq_number);
 
 private:
-    /* Socket control block */
-    Socket _socket;
+    /* Shared socket and event loop, replaced once when replies arrive on other shard */
+    Host& _host;
+    std::atomic<Socket*> _socket;
+    Reactor* _reactor;                  // Guarded by timer mutex
 
     /* TCU protocol control block */
     tcu_pcb _pcb;
-
-    /* Receiving thread params */
-    void receive_loop();
-    std::atomic<bool> _receive_running{false};
-    std::thread _receive_thread;
-
-    /* Keep-Alive thread params */
-    void keep_alive_loop();
-    std::atomic<bool> _keep_alive_running{false};
-    std::thread _keep_alive_thread;
+    void new_phase(int phase);          // Also counts open connections on host, releases closed peer
+    std::atomic<bool> _counted{false};
+    std::atomic<bool> _released{false};
+
+    /* Batched I/O params */
+    size_t prepare_packet(const tcu_packet& packet, bool service, unsigned char* header, struct iovec* iov, unsigned char* corrupted_byte);
+    void queue_packets(const tcu_packet* const* packets, size_t count, bool service, Transmitter& transmitter);  // Serializes packets for transmit stage
+
+    /* Executor params, kernel steers peer to one receiving thread and at most one worker drains inbox at a time */
+    struct inbound {
+        PoolBuffer buffer;
+        size_t length = 0;
+    };
+    std::unique_ptr<spsc_ring<inbound>> _inbox;     // Created by receiving thread on first datagram
+    std::atomic<bool> _inbox_scheduled{false};
+    std::atomic<size_t> _inbox_peak{0};
+    void drain_inbox();
+
+    /* Keep-Alive timer params */
+    void keep_alive_timeout();
+    void arm_keep_alive(std::chrono::seconds delay);
+    std::mutex _timer_mutex;            // Timer descriptor and its loop change when peer moves
+    int _keep_alive_timer = -1;
+    std::atomic<int> _keep_alive_attempt{0};    // Requests sent since last activity check, timer may run on other shard
 
     /* Sending params */
-    std::map<uint24_t, tcu_packet> _send_packets;
+    seq_ring<tcu_packet> _send_packets{TCU_RETRANSMIT_BUFFER_LEN, false};   // Retransmission buffer, released and not yet acknowledged, allocated on connect
     size_t _max_frag_size;
-
-    uint24_t _seq_num;
-    uint24_t _last_num;
-    uint24_t _total_num;
+    size_t _frag_size_limit = TCU_MAX_PROBE_LEN;        // Set by user, discovery never goes above
+
+    /* Path MTU discovery params */
+    bool _path_probing = true;
+    bool _path_probed = false;                          // Discovery ran for current connection
+    size_t _path_payload = TCU_MAX_PAYLOAD_LEN;         // Largest confirmed fragment payload
+    uint16_t _probe_acked = 0;                          // Last answered probe length, guarded by send mutex
+    void reset_path_mtu();
+    bool probe_path(size_t length);
+
+    std::vector<unsigned char> _send_prefix;            // Serialized file header, sent ahead of data
+    const unsigned char* _send_data = nullptr;          // Message being fragmented
+    unsigned char _send_trailer[TCU_MESSAGE_CRC_LEN]{}; // Message checksum, sent after data
+    void set_message_crc(uint16_t crc);
+    size_t _send_length = 0;                            // Prefix, data and checksum together
+
+    MappedFile* _send_source = nullptr;                 // Mapped file being sent, nullptr for text
+    size_t _send_released = 0;                          // Acknowledged file bytes already dropped from memory
+    void release_sent_file();
+    uint8_t _send_flags = TCU_HDR_NO_FLAG;              // Flags common for all fragments (FL for file)
+
+    tcu_packet build_fragment(uint32_t seq) const;
+    void send_fragments();
+    bool fragments_left(uint64_t count);    // Numbering of connection has room for message
+
+    /* Fragment numbering runs across messages of connection, restarts at 1 on connect */
+    void reset_numbering();
+
+    uint32_t _send_base;            // Oldest unacknowledged fragment
+    uint32_t _send_next;            // Next fragment to release
+    uint32_t _send_first;           // First fragment of message being sent
+    uint32_t _send_last;            // Final fragment of message being sent
+    std::mutex _send_mutex;         // Guards retransmission buffer against ack processing
+    std::condition_variable _send_cv;
+
+    Pacer _pacer;                   // Spaces data packets at measured delivery rate
+
+    std::unique_ptr<CongestionControl> _congestion;                         // Bounds fragments in flight, guarded by send mutex
+    std::map<uint32_t, std::chrono::steady_clock::time_point> _ack_points;  // Send time of fragments asking for ack, empty when resent
+    void mark_ack_point(const tcu_packet& packet);
+
+    /* Last resend of fragment, hole reported again within rto is not resent twice */
+    struct resend_mark {
+        uint32_t seq = 0;
+        std::chrono::steady_clock::time_point at;
+    };
+    std::vector<resend_mark> _resent;                                       // Slot per retransmission buffer entry, guarded by send mutex
+    bool claim_resend(uint32_t seq, std::chrono::steady_clock::time_point now);     // Records resend, false when already resent within rto
+    void acknowledge_until(uint32_t ack_seq);                               // Releases cumulatively acknowledged fragments, send mutex held
+
+    /* Fragment numbers are 32 bits, wire carries low 24 bits */
+    uint32_t _seq_num;              // Receiver, first fragment not yet acknowledged
+    uint32_t _last_num;             // Receiver, highest fragment that asked for acknowledgment
+    uint32_t _final_num;            // Receiver, final fragment once arrived, 0 before
+    uint32_t _total_num;
 
     std::atomic<bool> _ack_received;
 
+    std::atomic<std::chrono::steady_clock::time_point> _conf_sent;    // Connection or disconnection request
+    std::atomic<bool> _conf_retransmitted{false};
+    void sample_conf_rtt();
+
     bool _dynamic_window;
-    uint24_t _window_size;
+    uint32_t _window_size;          // Dynamic sizing goes past 24 bits with message length
     void dynamic_window_size();
 
     /* Receiving params */
-    std::map<uint24_t, tcu_packet> _received_packets;
+    seq_ring<tcu_packet> _received_packets{TCU_REORDER_BUFFER_LEN, false};  // Reorder buffer, fragments past first gap, allocated on connect
+    std::vector<unsigned char> _received_data;              // Message consumed in order
+    void store_fragment(const tcu_packet_view& packet, uint32_t seq);
+    void consume_fragment(const unsigned char* data, size_t length, bool file);
+    void start_message(bool file);
+    void finish_message();              // Drops message state, numbering continues
+    bool _receiving = false;            // Fragments of message arrived, not assembled yet
+
+    crc16_ctx _message_crc;             // End-to-end checksum over in-order received prefix
+    uint32_t _recv_next;                // First fragment not yet consumed
+
+    /* Flow control params */
+    size_t _received_bytes = 0;                             // Payload held in reorder buffer
+    size_t _receive_buffer_len = TCU_RECEIVE_BUFFER_LEN;    // Reorder buffer budget
+    size_t _recv_frag_size = 0;                             // Largest fragment of current message
+    uint24_t advertised_window() const;
+
+    uint32_t _peer_window = TCU_RETRANSMIT_BUFFER_LEN;      // Sender, guarded by send mutex
+    void update_peer_window(const tcu_packet_view& packet);
 
     std::chrono::steady_clock::time_point _receive_start_time_text;
     std::chrono::steady_clock::time_point _receive_start_time_file;
 
     /* File saving params*/
     std::string _file_path;
+    bool check_file_path();
+
+    bool _direct_file = true;                   // Fragmented files are written to disk as they arrive
+    std::unique_ptr<FileWriter> _file_writer;   // Target of file being received, retired when next file starts
 
     /* Error rate params (for testing) */
     double _error_rate = 0.0;
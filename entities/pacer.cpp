@@ -0,0 +1,214 @@
+/*
+ * pacer.cpp
+ */
+
+#include "pacer.h"
+
+Pacer::Pacer()
+{
+    _last_refill = clock::now();
+    _sample_start = _last_refill;
+}
+
+void Pacer::set_ceiling(uint64_t bytes_per_sec)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _ceiling = bytes_per_sec;
+    update_rate();
+}
+
+void Pacer::set_burst(size_t packets)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _burst_packets = std::clamp<size_t>(packets, 1, PACER_MAX_BURST);
+}
+
+uint64_t Pacer::get_ceiling() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _ceiling;
+}
+
+size_t Pacer::get_burst() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _burst_packets;
+}
+
+void Pacer::start(size_t packet_size)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _packet_size = packet_size;
+
+    std::fill(std::begin(_samples), std::end(_samples), 0.0);
+    _sample_next = 0;
+    _max_delivery = 0.0;
+    _startup_best = 0.0;
+    _startup_flat = 0;
+    _startup = true;
+
+    _rate = PACER_INITIAL_RATE;
+    update_rate();
+
+    // First burst may leave immediately
+    _last_refill = clock::now();
+    _tokens = static_cast<double>(_burst_packets * _packet_size);
+
+    _delivered = 0;
+    _sample_start = _last_refill;
+}
+
+void Pacer::refill(clock::time_point now)
+{
+    double elapsed = std::chrono::duration<double>(now - _last_refill).count();
+    double depth = static_cast<double>(_burst_packets * _packet_size);
+
+    _tokens = std::min(depth, _tokens + elapsed * _rate);
+    _last_refill = now;
+}
+
+void Pacer::wait(size_t bytes)
+{
+    clock::time_point deadline;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        clock::time_point now = clock::now();
+        refill(now);
+
+        // Batch larger than bucket waits for full bucket and leaves debt behind
+        double depth = static_cast<double>(_burst_packets * _packet_size);
+        double need = std::min(static_cast<double>(bytes), depth);
+
+        if (_tokens >= need)
+        {
+            _tokens -= static_cast<double>(bytes);
+            return;
+        }
+
+        // Tokens are reserved now, refill at deadline pays deficit back
+        auto delay = std::chrono::duration<double>((need - _tokens) / _rate);
+        deadline = now + std::chrono::duration_cast<clock::duration>(delay);
+        _tokens -= static_cast<double>(bytes);
+
+        _waits++;
+        _waited_us += std::chrono::duration_cast<std::chrono::microseconds>(delay).count();
+    }
+
+    sleep_until(deadline);
+}
+
+void Pacer::sleep_until(clock::time_point deadline)
+{
+    // Default 50 us slack would dominate spacing at high rates
+    thread_local bool slack_set = false;
+    if (!slack_set)
+    {
+        prctl(PR_SET_TIMERSLACK, PACER_TIMER_SLACK_NS, 0, 0, 0);
+        slack_set = true;
+    }
+
+    // Steady clock is CLOCK_MONOTONIC, absolute deadline does not drift across wakeups
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+
+    struct timespec ts{};
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+    {
+    }
+}
+
+void Pacer::on_delivered(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _delivered += bytes;
+
+    clock::time_point now = clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - _sample_start).count();
+    if (elapsed < PACER_SAMPLE_MIN_US)
+    {
+        return;
+    }
+
+    // Windowed max, short stalls in acknowledgments do not pull rate down
+    _samples[_sample_next] = static_cast<double>(_delivered) * 1e6 / static_cast<double>(elapsed);
+    _sample_next = (_sample_next + 1) % PACER_RATE_SAMPLES;
+    _max_delivery = *std::max_element(std::begin(_samples), std::end(_samples));
+
+    _delivered = 0;
+    _sample_start = now;
+
+    // Startup ends once delivery rate stops growing
+    if (_startup)
+    {
+        if (_max_delivery >= _startup_best * 1.25)
+        {
+            _startup_best = _max_delivery;
+            _startup_flat = 0;
+        }
+        else if (++_startup_flat >= PACER_STARTUP_ROUNDS)
+        {
+            _startup = false;
+            spdlog::info("[Pacer::on_delivered] startup finished, delivery rate {} B/s", static_cast<uint64_t>(_max_delivery));
+        }
+    }
+
+    update_rate();
+}
+
+void Pacer::update_rate()
+{
+    if (_max_delivery > 0.0)
+    {
+        if (_startup)
+        {
+            // Early samples include first round trip, never slow down while probing
+            _rate = std::max(_rate, _max_delivery * PACER_STARTUP_GAIN);
+        }
+        else
+        {
+            _rate = _max_delivery * PACER_STEADY_GAIN;
+        }
+    }
+
+    _rate = std::max(_rate, static_cast<double>(PACER_MIN_RATE));
+    if (_ceiling > 0)
+    {
+        _rate = std::min(_rate, static_cast<double>(_ceiling));
+    }
+}
+
+uint64_t Pacer::get_rate() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return static_cast<uint64_t>(_rate);
+}
+
+std::string Pacer::report() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::ostringstream out;
+    out << "pacer rate " << static_cast<uint64_t>(_rate) << " B/s"
+        << " delivery " << static_cast<uint64_t>(_max_delivery) << " B/s"
+        << " ceiling ";
+    if (_ceiling > 0)
+    {
+        out << _ceiling << " B/s";
+    }
+    else
+    {
+        out << "none";
+    }
+    out << " burst " << _burst_packets
+        << " waits " << _waits
+        << " (" << (_waits ? _waited_us / _waits : 0) << " us avg)";
+
+    return out.str();
+}
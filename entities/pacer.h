@@ -0,0 +1,93 @@
+/*
+ * pacer.h — Token Bucket Rate Pacer
+ *
+ * Releases data packets at target rate instead of fixed pause per packet.
+ * Target rate follows measured delivery rate (bytes acknowledged per interval),
+ * scaled by gain so link can be probed upwards, and is capped by configurable ceiling.
+ * Bucket depth limits microbursts, sender sleeps on absolute monotonic deadlines
+ * until enough tokens accumulated, so spacing holds without spinning on CPU.
+ */
+
+#pragma once
+
+#include <time.h>
+#include <sys/prctl.h>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <spdlog/spdlog.h>
+
+#define PACER_INITIAL_RATE      (16 * 1000 * 1000)  // Bytes per second before first delivery sample
+#define PACER_MIN_RATE          (64 * 1000)         // Floor, estimate never collapses below
+#define PACER_DEFAULT_BURST     16                  // Packets released back to back at most
+#define PACER_MAX_BURST         64
+#define PACER_SAMPLE_MIN_US     2000                // Shortest interval taken as delivery sample
+#define PACER_RATE_SAMPLES      8                   // Windowed max filter length
+#define PACER_STARTUP_GAIN      2.0                 // Rate doubles while delivery keeps growing
+#define PACER_STEADY_GAIN       1.25
+#define PACER_STARTUP_ROUNDS    3                   // Samples without 25 % growth ending startup
+#define PACER_TIMER_SLACK_NS    1000                // Sending thread wakeup slack
+
+class Pacer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    Pacer();
+
+    /* Configuration, 0 ceiling means unlimited */
+    void set_ceiling(uint64_t bytes_per_sec);
+    void set_burst(size_t packets);
+    [[nodiscard]] uint64_t get_ceiling() const;
+    [[nodiscard]] size_t get_burst() const;
+
+    /* New transfer, learned delivery rate is discarded */
+    void start(size_t packet_size);
+
+    /* Blocks until bytes may be released */
+    void wait(size_t bytes);
+
+    /* Acknowledgment feedback, called from receiving thread */
+    void on_delivered(size_t bytes);
+
+    [[nodiscard]] uint64_t get_rate() const;
+    std::string report() const;
+
+    /* Copy protection */
+    Pacer(const Pacer&) = delete;
+    Pacer& operator=(const Pacer&) = delete;
+
+private:
+    void update_rate();
+    void refill(clock::time_point now);
+    static void sleep_until(clock::time_point deadline);
+
+    mutable std::mutex _mutex;
+
+    /* Configuration */
+    uint64_t _ceiling = 0;
+    size_t _burst_packets = PACER_DEFAULT_BURST;
+    size_t _packet_size = 0;
+
+    /* Token bucket */
+    double _rate = PACER_INITIAL_RATE;      // Bytes per second
+    double _tokens = 0.0;                   // May go negative after batch larger than bucket
+    clock::time_point _last_refill;
+
+    /* Delivery rate estimation */
+    size_t _delivered = 0;                  // Bytes acknowledged since sample start
+    clock::time_point _sample_start;
+    double _samples[PACER_RATE_SAMPLES] = {};
+    size_t _sample_next = 0;
+    double _max_delivery = 0.0;
+    double _startup_best = 0.0;
+    int _startup_flat = 0;
+    bool _startup = true;
+
+    /* Statistics */
+    uint64_t _waits = 0;
+    uint64_t _waited_us = 0;
+};
@@ -0,0 +1,253 @@
+/*
+ * reactor.cpp
+ */
+
+#include "reactor.h"
+
+Reactor::Reactor()
+{
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0)
+    {
+        perror("epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wake_fd < 0)
+    {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+
+    // Wake descriptor is marked by empty pointer
+    struct epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event) < 0)
+    {
+        perror("epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+}
+
+Reactor::~Reactor()
+{
+    for (auto& [fd, entry] : _entries)
+    {
+        if (entry->timer)
+        {
+            close(fd);
+        }
+    }
+
+    close(_wake_fd);
+    close(_epoll_fd);
+}
+
+bool Reactor::add(int fd, uint32_t events, Handler handler)
+{
+    auto entry = std::make_unique<Entry>();
+    entry->fd = fd;
+    entry->timer = false;
+    entry->handler = std::move(handler);
+
+    struct epoll_event event{};
+    event.events = events;
+    event.data.ptr = entry.get();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        perror("epoll_ctl");
+        return false;
+    }
+
+    _entries[fd] = std::move(entry);
+    return true;
+}
+
+void Reactor::remove(int fd)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _entries.find(fd);
+    if (it == _entries.end())
+    {
+        return;
+    }
+
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+    // Event for it can be already fetched, so entry lives until dispatch ends
+    it->second->removed = true;
+    _removed.push_back(std::move(it->second));
+    _entries.erase(it);
+}
+
+int Reactor::add_timer(Handler handler)
+{
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0)
+    {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    if (!add(timer_fd, EPOLLIN, std::move(handler)))
+    {
+        close(timer_fd);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries[timer_fd]->timer = true;
+
+    return timer_fd;
+}
+
+void Reactor::arm_timer(int timer_fd, std::chrono::nanoseconds delay, std::chrono::nanoseconds interval)
+{
+    // Zero delay would disarm timer
+    if (delay.count() <= 0)
+    {
+        delay = std::chrono::nanoseconds(1);
+    }
+
+    struct itimerspec spec{};
+    spec.it_value.tv_sec = delay.count() / 1000000000;
+    spec.it_value.tv_nsec = delay.count() % 1000000000;
+    spec.it_interval.tv_sec = interval.count() / 1000000000;
+    spec.it_interval.tv_nsec = interval.count() % 1000000000;
+
+    if (timerfd_settime(timer_fd, 0, &spec, nullptr) < 0)
+    {
+        perror("timerfd_settime");
+    }
+}
+
+void Reactor::disarm_timer(int timer_fd)
+{
+    struct itimerspec spec{};
+    timerfd_settime(timer_fd, 0, &spec, nullptr);
+}
+
+std::chrono::nanoseconds Reactor::get_timer(int timer_fd) const
+{
+    struct itimerspec spec{};
+    if (timerfd_gettime(timer_fd, &spec) < 0)
+    {
+        return std::chrono::nanoseconds(0);
+    }
+
+    return std::chrono::seconds(spec.it_value.tv_sec) + std::chrono::nanoseconds(spec.it_value.tv_nsec);
+}
+
+void Reactor::remove_timer(int timer_fd)
+{
+    remove(timer_fd);
+    close(timer_fd);
+}
+
+void Reactor::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _posted.push_back(std::move(task));
+    }
+    wake();
+}
+
+void Reactor::wake()
+{
+    uint64_t value = 1;
+    if (write(_wake_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+    {
+        perror("eventfd write");
+    }
+}
+
+void Reactor::run_posted()
+{
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        tasks.swap(_posted);
+    }
+
+    for (auto& task : tasks)
+    {
+        task();
+    }
+}
+
+void Reactor::run()
+{
+    _loop_thread = std::this_thread::get_id();
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    // Tasks posted before loop started
+    run_posted();
+
+    while (!_stopped)
+    {
+        int count = epoll_wait(_epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count && !_stopped; i++)
+        {
+            auto* entry = static_cast<Entry*>(events[i].data.ptr);
+
+            if (entry == nullptr)
+            {
+                uint64_t value;
+                while (read(_wake_fd, &value, sizeof(value)) > 0) {}
+                run_posted();
+                continue;
+            }
+
+            if (entry->removed)
+            {
+                continue;
+            }
+
+            if (entry->timer)
+            {
+                uint64_t expirations;
+                if (read(entry->fd, &expirations, sizeof(expirations)) < 0)
+                {
+                    // Rearmed or disarmed after event was queued
+                    continue;
+                }
+            }
+
+            entry->handler(events[i].events);
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _removed.clear();
+    }
+
+    _loop_thread = std::thread::id();
+}
+
+void Reactor::stop()
+{
+    _stopped = true;
+    wake();
+}
+
+bool Reactor::in_loop_thread() const
+{
+    return _loop_thread.load() == std::this_thread::get_id();
+}
@@ -0,0 +1,80 @@
+/*
+ * reactor.h — epoll Event Loop
+ *
+ * Sockets, timers (timerfd) and cross-thread wakeups (eventfd) are all
+ * registered file descriptors, loop blocks in epoll_wait until one of them fires.
+ * Handlers run on thread calling run().
+ */
+
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cerrno>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define REACTOR_MAX_EVENTS      64
+
+class Reactor {
+public:
+    using Handler = std::function<void(uint32_t events)>;
+
+    Reactor();
+    ~Reactor();
+
+    /* Registration, safe from any thread */
+    bool add(int fd, uint32_t events, Handler handler);
+    void remove(int fd);
+
+    /* Timers, handler is called once per expiration batch */
+    int add_timer(Handler handler);         // Returns timer descriptor or -1
+    void arm_timer(int timer_fd, std::chrono::nanoseconds delay, std::chrono::nanoseconds interval = std::chrono::nanoseconds(0));
+    void disarm_timer(int timer_fd);
+    [[nodiscard]] std::chrono::nanoseconds get_timer(int timer_fd) const;     // Time to expiration, 0 when disarmed
+    void remove_timer(int timer_fd);
+
+    /* Run task on loop thread */
+    void post(std::function<void()> task);
+
+    void run();         // Until stop()
+    void stop();        // Wakes loop immediately
+
+    [[nodiscard]] bool in_loop_thread() const;
+
+    /* Copy protection */
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+private:
+    struct Entry {
+        int fd;
+        bool timer;
+        Handler handler;
+        std::atomic<bool> removed{false};
+    };
+
+    void wake();
+    void run_posted();
+
+    int _epoll_fd;
+    int _wake_fd;
+
+    std::mutex _mutex;
+    std::unordered_map<int, std::unique_ptr<Entry>> _entries;
+    std::vector<std::unique_ptr<Entry>> _removed;       // Freed after current dispatch
+    std::vector<std::function<void()>> _posted;
+
+    std::atomic<bool> _stopped{false};
+    std::atomic<std::thread::id> _loop_thread{};
+};
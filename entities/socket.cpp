@@ -26,6 +26,9 @@ int Socket::get_socket() const
 
 void Socket::close_socket()
 {
+    // Rings hold registered reference to socket
+    _uring.store(nullptr);
+
     if (_sock_desc != -1)
     {
         close(_sock_desc);
@@ -49,3 +52,193 @@ int Socket::set_non_blocking() const
     return 0;
 }
 
+int Socket::send_batch(struct mmsghdr* msgs, size_t count) const
+{
+    // Ring stays alive until this send completes, even when loop thread disables it meanwhile
+    if (std::shared_ptr<Uring> uring = _uring.load())
+    {
+        return uring->send_batch(msgs, count);
+    }
+
+    size_t sent = 0;
+
+    // Kernel can accept only part of batch
+    while (sent < count)
+    {
+        int result = sendmmsg(_sock_desc, msgs + sent, count - sent, 0);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            // Full socket buffer is left to caller
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                perror("sendmmsg");
+            }
+            return sent > 0 ? static_cast<int>(sent) : -1;
+        }
+        sent += result;
+    }
+
+    return static_cast<int>(sent);
+}
+
+int Socket::receive_batch(ReceiveBatch& batch, size_t count) const
+{
+    if (count > batch.get_capacity())
+    {
+        count = batch.get_capacity();
+    }
+
+    // Reset lengths changed by previous call
+    for (size_t i = 0; i < count; i++)
+    {
+        batch._msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+    }
+
+    int result = recvmmsg(_sock_desc, batch._msgs.data(), count, MSG_DONTWAIT, nullptr);
+    if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        perror("recvmmsg");
+    }
+
+    return result;
+}
+
+bool Socket::gso_supported() const
+{
+    // Probe by setting and clearing socket default segment size
+    int segment_size = SOCKET_GSO_PROBE_LEN;
+    if (setsockopt(_sock_desc, SOL_UDP, UDP_SEGMENT, &segment_size, sizeof(segment_size)) < 0)
+    {
+        return false;
+    }
+
+    segment_size = 0;
+    setsockopt(_sock_desc, SOL_UDP, UDP_SEGMENT, &segment_size, sizeof(segment_size));
+    return true;
+}
+
+ssize_t Socket::send_segmented(const sockaddr_in& addr, const struct iovec* iov, size_t iov_count, uint16_t segment_size) const
+{
+    char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+
+    struct msghdr msg{};
+    msg.msg_name = const_cast<sockaddr_in*>(&addr);
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = const_cast<struct iovec*>(iov);
+    msg.msg_iovlen = iov_count;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    std::memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+
+    return sendmsg(_sock_desc, &msg, 0);
+}
+
+bool Socket::set_dont_fragment() const
+{
+    // Probe mode ignores cached path MTU, path probing decides datagram size
+    int value = IP_PMTUDISC_PROBE;
+    return setsockopt(_sock_desc, IPPROTO_IP, IP_MTU_DISCOVER, &value, sizeof(value)) == 0;
+}
+
+bool Socket::set_gro(bool enabled) const
+{
+    int value = enabled ? 1 : 0;
+    return setsockopt(_sock_desc, SOL_UDP, UDP_GRO, &value, sizeof(value)) == 0;
+}
+
+ssize_t Socket::receive_segmented(unsigned char* buff, size_t length, sockaddr_in& addr, uint16_t& segment_size) const
+{
+    char control[CMSG_SPACE(sizeof(int))] = {};
+    struct iovec iov = {buff, length};
+
+    struct msghdr msg{};
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t result = recvmsg(_sock_desc, &msg, MSG_DONTWAIT);
+    segment_size = 0;
+
+    if (result < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            perror("recvmsg");
+        }
+        return result;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+        {
+            int gso_size;
+            std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+            segment_size = static_cast<uint16_t>(gso_size);
+        }
+    }
+
+    return result;
+}
+
+bool Socket::set_uring(bool enabled)
+{
+    if (!enabled)
+    {
+        _uring.store(nullptr);
+        return true;
+    }
+
+    if (_uring.load())
+    {
+        return true;
+    }
+
+    auto uring = std::make_shared<Uring>(_sock_desc, SOCKET_RECV_BUFF_LEN);
+    if (!uring->init())
+    {
+        return false;
+    }
+
+    _uring.store(std::move(uring));
+    return true;
+}
+
+int Socket::get_uring() const
+{
+    std::shared_ptr<Uring> uring = _uring.load();
+    return uring ? uring->get_fd() : -1;
+}
+
+size_t Socket::receive_uring(const Uring::Handler& handler) const
+{
+    std::shared_ptr<Uring> uring = _uring.load();
+    return uring ? uring->receive(handler) : 0;
+}
+
+ReceiveBatch::ReceiveBatch(size_t capacity, size_t buff_len) : _buff_len(buff_len), _buffers(capacity * buff_len), _iov(capacity), _addrs(capacity), _msgs(capacity)
+{
+    for (size_t i = 0; i < capacity; i++)
+    {
+        _iov[i].iov_base = _buffers.data() + i * buff_len;
+        _iov[i].iov_len = buff_len;
+
+        _msgs[i] = {};
+        _msgs[i].msg_hdr.msg_name = &_addrs[i];
+        _msgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        _msgs[i].msg_hdr.msg_iov = &_iov[i];
+        _msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+}
@@ -5,9 +5,49 @@
 #pragma once
 
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <unistd.h>
 #include <stdexcept>
 #include <fcntl.h>
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+
+#include "uring.h"
+
+#define SOCKET_MAX_BATCH        64      // Datagrams per sendmmsg / recvmmsg call
+#define SOCKET_RECV_BUFF_LEN    65536   // Receive buffer per datagram, fits jumbo and loopback fragments
+
+#define SOCKET_GSO_MAX_SEGMENTS 64      // Kernel UDP_MAX_SEGMENTS
+#define SOCKET_GSO_MAX_BYTES    65507   // Largest UDP payload
+#define SOCKET_GRO_BUFF_LEN     65536   // Coalesced receive buffer
+#define SOCKET_GSO_PROBE_LEN    1472    // Segment size of offload probe, ethernet sized datagram, kernel refuses above 65535
+
+/* Pre-allocated ring of receive buffers drained with single recvmmsg */
+class ReceiveBatch {
+public:
+    ReceiveBatch(size_t capacity, size_t buff_len);
+
+    [[nodiscard]] size_t get_capacity() const { return _msgs.size(); }
+
+    [[nodiscard]] const unsigned char* data(size_t i) const { return _buffers.data() + i * _buff_len; }
+    [[nodiscard]] size_t length(size_t i) const { return _msgs[i].msg_len; }
+    [[nodiscard]] const sockaddr_in& addr(size_t i) const { return _addrs[i]; }
+
+private:
+    friend class Socket;
+
+    size_t _buff_len;
+    std::vector<unsigned char> _buffers;
+    std::vector<struct iovec> _iov;
+    std::vector<sockaddr_in> _addrs;
+    std::vector<struct mmsghdr> _msgs;
+};
 
 class Socket {
 public:
@@ -19,10 +59,32 @@ public:
     [[nodiscard]] int get_socket() const;
     void close_socket();
 
+    /* Batched I/O, return number of datagrams or -1 on error */
+    int send_batch(struct mmsghdr* msgs, size_t count) const;
+    int receive_batch(ReceiveBatch& batch, size_t count) const;
+
+    /* UDP segmentation offload, kernel splits buffer into segment_size datagrams */
+    [[nodiscard]] bool gso_supported() const;
+    ssize_t send_segmented(const sockaddr_in& addr, const struct iovec* iov, size_t iov_count, uint16_t segment_size) const;
+
+    /* UDP receive offload, segment_size is 0 when datagram was not coalesced */
+    bool set_gro(bool enabled) const;
+    ssize_t receive_segmented(unsigned char* buff, size_t length, sockaddr_in& addr, uint16_t& segment_size) const;
+
+    /* DF on every datagram, oversized sends fail with EMSGSIZE instead of IP fragmentation */
+    bool set_dont_fragment() const;
+
+    /* io_uring backend, send_batch goes through linked submissions while enabled */
+    bool set_uring(bool enabled);                   // False when kernel lacks support
+    [[nodiscard]] bool uring_enabled() const { return _uring.load() != nullptr; }
+    [[nodiscard]] int get_uring() const;            // Receive completion descriptor for epoll
+    size_t receive_uring(const Uring::Handler& handler) const;
+
     /* Copy protection */
     Socket(const Socket&) = delete;
     Socket& operator=(const Socket&) = delete;
 
 private:
     int _sock_desc;
+    std::atomic<std::shared_ptr<Uring>> _uring;     // Senders on other threads hold own reference while toggled
 };
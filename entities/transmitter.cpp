@@ -0,0 +1,251 @@
+/*
+ * transmitter.cpp
+ */
+
+#include "transmitter.h"
+
+static std::atomic<uint64_t> transmitter_ids{0};
+
+Transmitter::Transmitter(Socket& socket) : _socket(socket), _id(transmitter_ids.fetch_add(1, std::memory_order_relaxed))
+{
+    _thread = std::thread(&Transmitter::run, this);
+}
+
+Transmitter::~Transmitter()
+{
+    stop();
+}
+
+void Transmitter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+        _running = false;
+    }
+    _wake_cv.notify_one();
+
+    if (_thread.joinable())
+    {
+        _thread.join();
+    }
+}
+
+Transmitter::Ring* Transmitter::producer_ring()
+{
+    // Stale entries of destroyed instances are never looked up again
+    thread_local std::unordered_map<uint64_t, Ring*> rings;
+
+    auto it = rings.find(_id);
+    if (it != rings.end())
+    {
+        return it->second;
+    }
+
+    std::lock_guard<std::mutex> lock(_rings_mutex);
+
+    size_t count = _ring_count.load(std::memory_order_relaxed);
+    if (count >= TX_MAX_PRODUCERS)
+    {
+        return nullptr;
+    }
+
+    _owned.push_back(std::make_unique<Ring>(TX_RING_LEN));
+    _rings[count] = _owned.back().get();
+    _ring_count.store(count + 1, std::memory_order_release);
+
+    rings[_id] = _rings[count];
+    spdlog::info("[Transmitter::producer_ring] registered producer ring {}", count);
+    return _rings[count];
+}
+
+size_t Transmitter::push(tx_datagram* datagrams, size_t count)
+{
+    Ring* ring = producer_ring();
+    if (ring == nullptr || !_running.load(std::memory_order_relaxed))
+    {
+        _dropped.fetch_add(count, std::memory_order_relaxed);
+        return 0;
+    }
+
+    size_t queued = 0;
+    while (true)
+    {
+        queued += ring->push_batch(datagrams + queued, count - queued);
+        wake();
+
+        if (queued == count)
+        {
+            return queued;
+        }
+
+        // Transmit thread fell behind, producer slows down instead of dropping
+        _full_waits.fetch_add(1, std::memory_order_relaxed);
+        if (!_running.load(std::memory_order_relaxed))
+        {
+            _dropped.fetch_add(count - queued, std::memory_order_relaxed);
+            return queued;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void Transmitter::wake()
+{
+    // Pairs with fence in run, either sleeper sees new datagrams or producer sees sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleeping.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> lock(_wake_mutex);
+            _signal = true;
+        }
+        _wake_cv.notify_one();
+    }
+}
+
+bool Transmitter::pending() const
+{
+    size_t count = _ring_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!_rings[i]->empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Transmitter::run()
+{
+    tx_datagram batch[SOCKET_MAX_BATCH];
+    size_t start = 0;
+
+    while (true)
+    {
+        // Rotating first ring, busy producer cannot starve others
+        size_t count = _ring_count.load(std::memory_order_acquire);
+        size_t ready = 0;
+        for (size_t i = 0; i < count && ready < SOCKET_MAX_BATCH; i++)
+        {
+            Ring* ring = _rings[(start + i) % count];
+
+            size_t depth = ring->size();
+            if (depth == 0)
+            {
+                continue;
+            }
+
+            if (depth > _depth_peak.load(std::memory_order_relaxed))
+            {
+                _depth_peak.store(depth, std::memory_order_relaxed);
+            }
+            _depth_sum.fetch_add(depth, std::memory_order_relaxed);
+            _depth_samples.fetch_add(1, std::memory_order_relaxed);
+
+            ready += ring->pop_batch(batch + ready, SOCKET_MAX_BATCH - ready);
+        }
+        start++;
+
+        if (ready > 0)
+        {
+            send(batch, ready);
+            continue;
+        }
+
+        // Queued datagrams are sent before stopping
+        if (!_running.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(_wake_mutex);
+        _sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!pending())
+        {
+            _wake_cv.wait(lock, [this]() { return _signal || !_running.load(std::memory_order_relaxed); });
+        }
+        _signal = false;
+        _sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+void Transmitter::send(tx_datagram* datagrams, size_t count)
+{
+    struct iovec iov[SOCKET_MAX_BATCH];
+    struct mmsghdr msgs[SOCKET_MAX_BATCH];
+
+    for (size_t i = 0; i < count; i++)
+    {
+        iov[i] = {datagrams[i].buffer.data(), datagrams[i].length};
+
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_name = &datagrams[i].addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(datagrams[i].addr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t sent = 0;
+    uint64_t syscalls = 0;
+    while (sent < count)
+    {
+        int result = _socket.send_batch(msgs + sent, count - sent);
+        syscalls++;
+
+        if (result > 0)
+        {
+            sent += result;
+            continue;
+        }
+
+        // Socket buffer full, rest of batch waits for kernel to drain it
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+        {
+            _blocked.fetch_add(1, std::memory_order_relaxed);
+
+            struct pollfd pfd{_socket.get_socket(), POLLOUT, 0};
+            if (poll(&pfd, 1, TX_BLOCKED_WAIT_MS) > 0)
+            {
+                continue;
+            }
+        }
+        break;
+    }
+
+    Stats& stats = Stats::get_instance();
+    stats.tx_packets.fetch_add(sent, std::memory_order_relaxed);
+    stats.tx_syscalls.fetch_add(syscalls, std::memory_order_relaxed);
+
+    _datagrams.fetch_add(sent, std::memory_order_relaxed);
+    _dropped.fetch_add(count - sent, std::memory_order_relaxed);
+    _batches.fetch_add(1, std::memory_order_relaxed);
+
+    spdlog::info("[Transmitter::send] sent {}/{} datagrams", sent, count);
+
+    // Buffers go back to pool here, on transmit thread
+    for (size_t i = 0; i < count; i++)
+    {
+        datagrams[i].buffer.reset();
+    }
+}
+
+std::string Transmitter::report() const
+{
+    uint64_t batches = _batches.load(std::memory_order_relaxed);
+    uint64_t samples = _depth_samples.load(std::memory_order_relaxed);
+
+    std::ostringstream out;
+    out << "transmitter rings " << _ring_count.load(std::memory_order_relaxed)
+        << " datagrams " << _datagrams.load(std::memory_order_relaxed)
+        << " batches " << batches
+        << " avg batch " << (batches > 0 ? _datagrams.load(std::memory_order_relaxed) / batches : 0)
+        << " depth peak " << _depth_peak.load(std::memory_order_relaxed)
+        << " avg " << (samples > 0 ? _depth_sum.load(std::memory_order_relaxed) / samples : 0)
+        << " full waits " << _full_waits.load(std::memory_order_relaxed)
+        << " blocked " << _blocked.load(std::memory_order_relaxed)
+        << " dropped " << _dropped.load(std::memory_order_relaxed);
+
+    return out.str();
+}
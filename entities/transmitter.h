@@ -0,0 +1,97 @@
+/*
+ * transmitter.h — Transmit Stage
+ *
+ * Single thread owns sending on host socket. Every thread that sends (commands,
+ * receiving shards, executor workers, timers) gets own SPSC ring on first use,
+ * so producers never contend with each other and packets of one producer keep
+ * their order. Transmit thread collects datagrams from all rings into one batch
+ * and sends it with one syscall, then sleeps while every ring is empty.
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+#include "socket.h"
+#include "../types/spsc_ring.h"
+#include "../tools/buffer_pool.h"
+#include "../tools/stats.h"
+
+#define TX_RING_LEN             4096    // Datagrams queued per producing thread, producer waits when full
+#define TX_MAX_PRODUCERS        256     // Threads with own ring, datagrams of further ones are dropped
+#define TX_BLOCKED_WAIT_MS      1000    // Wait for writable socket, rest of batch is dropped after it
+
+/* Serialized datagram, header and payload copied so sender may release fragment */
+struct tx_datagram {
+    PoolBuffer buffer;
+    size_t length = 0;
+    sockaddr_in addr{};
+};
+
+class Transmitter {
+public:
+    explicit Transmitter(Socket& socket);
+    ~Transmitter();
+
+    /* Queues datagrams on ring of calling thread, returns number queued */
+    size_t push(tx_datagram* datagrams, size_t count);
+
+    void stop();        // Sends what is queued, later pushes are dropped
+
+    std::string report() const;
+
+    /* Copy protection */
+    Transmitter(const Transmitter&) = delete;
+    Transmitter& operator=(const Transmitter&) = delete;
+
+private:
+    using Ring = spsc_ring<tx_datagram>;
+
+    Ring* producer_ring();          // Registers ring of calling thread on first use
+    bool pending() const;
+    void run();
+    void send(tx_datagram* datagrams, size_t count);
+    void wake();
+
+    Socket& _socket;
+    uint64_t _id;                   // Key of thread local ring lookup, unique per instance
+
+    /* Producer rings, slots are published by count and never removed */
+    std::mutex _rings_mutex;
+    std::vector<std::unique_ptr<Ring>> _owned;
+    Ring* _rings[TX_MAX_PRODUCERS] = {};
+    std::atomic<size_t> _ring_count{0};
+
+    /* Sleeping transmit thread */
+    std::thread _thread;
+    std::atomic<bool> _running{true};
+    std::atomic<bool> _sleeping{false};
+    std::mutex _wake_mutex;
+    std::condition_variable _wake_cv;
+    bool _signal = false;
+
+    /* Statistics, queue depth sampled when ring is drained */
+    std::atomic<uint64_t> _datagrams{0};
+    std::atomic<uint64_t> _batches{0};
+    std::atomic<uint64_t> _dropped{0};          // Producer beyond ring limit, stopped stage or send error
+    std::atomic<uint64_t> _blocked{0};          // Sends that found socket buffer full
+    std::atomic<uint64_t> _full_waits{0};
+    std::atomic<size_t> _depth_peak{0};
+    std::atomic<uint64_t> _depth_sum{0};
+    std::atomic<uint64_t> _depth_samples{0};
+};
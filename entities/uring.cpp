@@ -0,0 +1,448 @@
+/*
+ * uring.cpp
+ */
+
+#include "uring.h"
+
+namespace {
+
+int uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args)
+{
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+}
+
+bool uring_queue::setup(unsigned entries, unsigned cq_entries)
+{
+    struct io_uring_params params{};
+    if (cq_entries > 0)
+    {
+        params.flags |= IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+    }
+
+    fd = uring_setup(entries, &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // Newer kernels map both rings with one region
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        ring_size = std::max(ring_size, cq_size);
+    }
+
+    ring_ptr = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring_ptr == MAP_FAILED)
+    {
+        ring_ptr = nullptr;
+        destroy();
+        return false;
+    }
+
+    if (single_mmap)
+    {
+        cq_ptr = ring_ptr;
+    }
+    else
+    {
+        cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED)
+        {
+            cq_ptr = nullptr;
+            destroy();
+            return false;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED)
+    {
+        destroy();
+        return false;
+    }
+    sqes = static_cast<struct io_uring_sqe*>(sqes_ptr);
+
+    auto* sq = static_cast<unsigned char*>(ring_ptr);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_pending = *sq_tail;
+
+    // Identity index array, entry i always points to sqes[i]
+    auto* sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    for (unsigned i = 0; i < sq_entries; i++)
+    {
+        sq_array[i] = i;
+    }
+
+    auto* cq = static_cast<unsigned char*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+void uring_queue::destroy()
+{
+    if (sqes != nullptr)
+    {
+        munmap(sqes, sqes_size);
+        sqes = nullptr;
+    }
+    if (cq_ptr != nullptr && cq_ptr != ring_ptr)
+    {
+        munmap(cq_ptr, cq_size);
+    }
+    cq_ptr = nullptr;
+    if (ring_ptr != nullptr)
+    {
+        munmap(ring_ptr, ring_size);
+        ring_ptr = nullptr;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+}
+
+struct io_uring_sqe* uring_queue::get_sqe()
+{
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sq_pending - head >= sq_entries)
+    {
+        return nullptr;
+    }
+
+    struct io_uring_sqe* sqe = &sqes[sq_pending & sq_mask];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_pending++;
+
+    return sqe;
+}
+
+int uring_queue::submit(unsigned wait_count)
+{
+    unsigned to_submit = sq_pending - *sq_tail;
+    __atomic_store_n(sq_tail, sq_pending, __ATOMIC_RELEASE);
+
+    int result;
+    do
+    {
+        result = uring_enter(fd, to_submit, wait_count, wait_count > 0 ? IORING_ENTER_GETEVENTS : 0);
+    }
+    while (result < 0 && errno == EINTR);
+
+    return result;
+}
+
+struct io_uring_cqe* uring_queue::peek_cqe()
+{
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+    {
+        return nullptr;
+    }
+
+    return &cqes[head & cq_mask];
+}
+
+void uring_queue::cqe_seen()
+{
+    __atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+}
+
+Uring::Uring(int sock_desc, size_t buff_len) : _sock_desc(sock_desc), _payload_len(buff_len)
+{
+    _recv_msg.msg_namelen = sizeof(sockaddr_in);
+    _buff_len = sizeof(struct io_uring_recvmsg_out) + sizeof(sockaddr_in) + _payload_len;
+}
+
+Uring::~Uring()
+{
+    // Closing ring cancels armed multishot receive
+    _recv.destroy();
+    _send.destroy();
+
+    if (_buf_ring != nullptr)
+    {
+        munmap(_buf_ring, _buf_ring_size);
+    }
+    if (_buffers != nullptr)
+    {
+        munmap(_buffers, _buffers_size);
+    }
+}
+
+bool Uring::init()
+{
+    if (!_recv.setup(URING_RECV_ENTRIES, URING_RECV_CQ_ENTRIES) || !_send.setup(URING_SEND_ENTRIES, 0))
+    {
+        perror("io_uring_setup");
+        return false;
+    }
+
+    if (!register_socket(_recv) || !register_socket(_send))
+    {
+        perror("io_uring_register files");
+        return false;
+    }
+
+    // Provided buffer rings appeared in 5.19
+    if (!setup_buffers())
+    {
+        perror("io_uring_register pbuf ring");
+        return false;
+    }
+
+    if (!arm_receive())
+    {
+        return false;
+    }
+
+    // Multishot recvmsg (6.0) is rejected right away on older kernels
+    struct io_uring_cqe* cqe = _recv.peek_cqe();
+    if (cqe != nullptr && cqe->user_data == URING_RECV_TAG && cqe->res == -EINVAL)
+    {
+        _recv.cqe_seen();
+        errno = EINVAL;
+        perror("io_uring multishot recvmsg");
+        return false;
+    }
+
+    return true;
+}
+
+bool Uring::register_socket(uring_queue& queue) const
+{
+    int fds[1] = {_sock_desc};
+    return uring_register(queue.fd, IORING_REGISTER_FILES, fds, 1) == 0;
+}
+
+bool Uring::setup_buffers()
+{
+    _buf_ring_size = URING_RECV_BUFFERS * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, _buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        return false;
+    }
+    _buf_ring = static_cast<struct io_uring_buf_ring*>(ring);
+
+    _buffers_size = URING_RECV_BUFFERS * _buff_len;
+    void* buffers = mmap(nullptr, _buffers_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (buffers == MAP_FAILED)
+    {
+        _buffers = nullptr;
+        return false;
+    }
+    _buffers = static_cast<unsigned char*>(buffers);
+
+    struct io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(_buf_ring);
+    reg.ring_entries = URING_RECV_BUFFERS;
+    reg.bgid = URING_BUFFER_GROUP;
+
+    if (uring_register(_recv.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        return false;
+    }
+
+    for (uint16_t bid = 0; bid < URING_RECV_BUFFERS; bid++)
+    {
+        recycle_buffer(bid);
+    }
+    __atomic_store_n(&_buf_ring->tail, _buf_tail, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+void Uring::recycle_buffer(uint16_t bid)
+{
+    // Flexible array wrapper gets non-zero size in C++, so index from ring start
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(_buf_ring) + (_buf_tail & (URING_RECV_BUFFERS - 1));
+    buf->addr = reinterpret_cast<uint64_t>(_buffers + bid * _buff_len);
+    buf->len = static_cast<uint32_t>(_buff_len);
+    buf->bid = bid;
+    _buf_tail++;
+}
+
+bool Uring::arm_receive()
+{
+    struct io_uring_sqe* sqe = _recv.get_sqe();
+    if (sqe == nullptr)
+    {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = 0;                                    // Index in registered files
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->addr = reinterpret_cast<uint64_t>(&_recv_msg);
+    sqe->len = 1;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = URING_RECV_TAG;
+
+    _enter_count.fetch_add(1, std::memory_order_relaxed);
+    if (_recv.submit(0) < 0)
+    {
+        perror("io_uring_enter");
+        return false;
+    }
+
+    return true;
+}
+
+size_t Uring::receive(const Handler& handler)
+{
+    size_t received = 0;
+    bool rearm = false;
+
+    struct io_uring_cqe* cqe;
+    while ((cqe = _recv.peek_cqe()) != nullptr)
+    {
+        int32_t res = cqe->res;
+        uint32_t flags = cqe->flags;
+        _recv.cqe_seen();
+
+        // Multishot ends on error or when provided buffers run out
+        if (!(flags & IORING_CQE_F_MORE))
+        {
+            rearm = true;
+        }
+
+        if (res < 0)
+        {
+            if (res != -ENOBUFS && res != -ECANCELED)
+            {
+                errno = -res;
+                perror("io_uring recvmsg");
+            }
+            continue;
+        }
+
+        if (!(flags & IORING_CQE_F_BUFFER))
+        {
+            continue;
+        }
+
+        auto bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        unsigned char* buff = _buffers + bid * _buff_len;
+
+        auto* out = reinterpret_cast<struct io_uring_recvmsg_out*>(buff);
+        const unsigned char* name = buff + sizeof(*out);
+        const unsigned char* payload = name + _recv_msg.msg_namelen + _recv_msg.msg_controllen;
+
+        if (!(out->flags & MSG_TRUNC))
+        {
+            sockaddr_in addr{};
+            std::memcpy(&addr, name, std::min<size_t>(out->namelen, sizeof(addr)));
+
+            handler(payload, out->payloadlen, addr);
+            received++;
+        }
+
+        recycle_buffer(bid);
+    }
+
+    __atomic_store_n(&_buf_ring->tail, _buf_tail, __ATOMIC_RELEASE);
+
+    if (rearm)
+    {
+        arm_receive();
+    }
+
+    return received;
+}
+
+int Uring::send_batch(struct mmsghdr* msgs, size_t count)
+{
+    std::lock_guard<std::mutex> lock(_send_mutex);
+
+    size_t sent = 0;
+
+    while (sent < count)
+    {
+        size_t chunk = std::min<size_t>(count - sent, _send.sq_entries);
+
+        // Linked chain keeps datagrams in window order
+        for (size_t i = 0; i < chunk; i++)
+        {
+            struct io_uring_sqe* sqe = _send.get_sqe();
+
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = 0;
+            sqe->flags = IOSQE_FIXED_FILE | (i + 1 < chunk ? IOSQE_IO_LINK : 0);
+            sqe->addr = reinterpret_cast<uint64_t>(&msgs[sent + i].msg_hdr);
+            sqe->len = 1;
+            sqe->user_data = sent + i;
+        }
+
+        _enter_count.fetch_add(1, std::memory_order_relaxed);
+        if (_send.submit(static_cast<unsigned>(chunk)) < 0)
+        {
+            perror("io_uring_enter");
+            return sent > 0 ? static_cast<int>(sent) : -1;
+        }
+
+        // Failed link cancels rest of chain
+        size_t completed = 0;
+        int error = 0;
+        for (size_t reaped = 0; reaped < chunk;)
+        {
+            struct io_uring_cqe* cqe = _send.peek_cqe();
+            if (cqe == nullptr)
+            {
+                _enter_count.fetch_add(1, std::memory_order_relaxed);
+                _send.submit(static_cast<unsigned>(chunk - reaped));
+                continue;
+            }
+
+            if (cqe->res >= 0)
+            {
+                msgs[cqe->user_data].msg_len = static_cast<unsigned>(cqe->res);
+                completed++;
+            }
+            else if (error == 0 && cqe->res != -ECANCELED)
+            {
+                error = -cqe->res;
+            }
+
+            _send.cqe_seen();
+            reaped++;
+        }
+
+        sent += completed;
+
+        if (completed < chunk)
+        {
+            errno = error != 0 ? error : ECANCELED;
+            perror("io_uring sendmsg");
+            return sent > 0 ? static_cast<int>(sent) : -1;
+        }
+    }
+
+    return static_cast<int>(sent);
+}
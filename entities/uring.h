@@ -0,0 +1,116 @@
+/*
+ * uring.h — io_uring Transport Backend
+ *
+ * Receive ring keeps one multishot recvmsg armed on UDP socket, datagrams land in
+ * provided buffer ring and completions are reaped from shared memory without syscall.
+ * Send ring submits window as linked sendmsg chain with single io_uring_enter.
+ * Socket is registered as fixed file on both rings.
+ */
+
+#pragma once
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#define URING_SEND_ENTRIES      64      // Linked sends per submission, matches SOCKET_MAX_BATCH
+#define URING_RECV_ENTRIES      8
+#define URING_RECV_CQ_ENTRIES   1024    // Completion space for multishot bursts
+#define URING_RECV_BUFFERS      256     // Provided buffers, power of two
+#define URING_BUFFER_GROUP      0
+#define URING_RECV_TAG          0xFFFFFFFFFFFFFFFFULL
+
+/* Single submission / completion queue pair mapped from kernel */
+struct uring_queue {
+    int fd = -1;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned sq_pending = 0;            // Local tail, published on submit
+    struct io_uring_sqe* sqes = nullptr;
+
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    struct io_uring_cqe* cqes = nullptr;
+
+    void* ring_ptr = nullptr;
+    size_t ring_size = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_size = 0;
+    size_t sqes_size = 0;
+
+    bool setup(unsigned entries, unsigned cq_entries);
+    void destroy();
+
+    struct io_uring_sqe* get_sqe();                 // nullptr when queue is full
+    int submit(unsigned wait_count);                // Publishes pending entries, waits for wait_count completions
+
+    struct io_uring_cqe* peek_cqe();
+    void cqe_seen();
+};
+
+class Uring {
+public:
+    using Handler = std::function<void(const unsigned char* data, size_t length, const sockaddr_in& addr)>;
+
+    Uring(int sock_desc, size_t buff_len);      // buff_len is largest datagram
+    ~Uring();
+
+    /* Maps rings and arms receive, false when kernel lacks support */
+    bool init();
+
+    /* Receive completion descriptor, readable in epoll when datagrams are ready */
+    [[nodiscard]] int get_fd() const { return _recv.fd; }
+
+    /* Reap ready datagrams, returns number passed to handler */
+    size_t receive(const Handler& handler);
+
+    /* Linked send chain, returns number of datagrams sent or -1 on error */
+    int send_batch(struct mmsghdr* msgs, size_t count);
+
+    /* io_uring_enter calls made so far */
+    [[nodiscard]] uint64_t get_enter_count() const { return _enter_count.load(std::memory_order_relaxed); }
+
+    /* Copy protection */
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+private:
+    bool register_socket(uring_queue& queue) const;
+    bool setup_buffers();
+    bool arm_receive();
+    void recycle_buffer(uint16_t bid);
+
+    int _sock_desc;
+
+    uring_queue _recv;
+    uring_queue _send;
+    std::mutex _send_mutex;
+
+    /* Provided buffer ring, slot is recvmsg_out header, source address and payload */
+    struct io_uring_buf_ring* _buf_ring = nullptr;
+    size_t _buf_ring_size = 0;
+    unsigned char* _buffers = nullptr;
+    size_t _buffers_size = 0;
+    size_t _payload_len;
+    size_t _buff_len = 0;
+    uint16_t _buf_tail = 0;
+
+    struct msghdr _recv_msg{};
+
+    std::atomic<uint64_t> _enter_count{0};
+};
@@ -2,7 +2,7 @@
  * main.cpp
  */
 
-#include "entities/node.h"
+#include "entities/host.h"
 #include "tools/cli.h"
 #include "tools/logger.h"
 
@@ -11,9 +11,9 @@ int main()
     auto logger = Logger::get_instance();
     Logger::get_instance()->clear_logs();
 
-    Node _node;
+    Host _host;
 
-    CLI _cli(&_node);
+    CLI _cli(&_host);
     _cli.run();
 
     return 0;
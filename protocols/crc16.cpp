@@ -0,0 +1,281 @@
+/*
+ * crc16.cpp
+ */
+
+#include "crc16.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRC16_HAVE_CLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using crc16_table = std::array<std::array<uint16_t, 256>, 8>;
+
+/* T[k][v] is CRC contribution of byte v followed by k zero bytes */
+constexpr crc16_table make_tables()
+{
+    crc16_table tables{};
+
+    for (uint32_t v = 0; v < 256; v++)
+    {
+        uint16_t crc = v << 8;
+        for (uint8_t j = 0; j < 8; j++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_CCITT_POLY : crc << 1;
+        }
+        tables[0][v] = crc;
+    }
+
+    for (size_t k = 1; k < 8; k++)
+    {
+        for (uint32_t v = 0; v < 256; v++)
+        {
+            uint16_t prev = tables[k - 1][v];
+            tables[k][v] = (prev << 8) ^ tables[0][prev >> 8];
+        }
+    }
+
+    return tables;
+}
+
+constexpr crc16_table tables = make_tables();
+
+uint16_t crc16_bitwise(uint16_t crc, const unsigned char* data, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        crc ^= (data[i] << 8);
+
+        for (uint8_t j = 0; j < 8; j++)
+        {
+            if (crc & 0x8000)
+            {
+                crc = (crc << 1) ^ CRC16_CCITT_POLY;
+            }
+            else
+            {
+                crc <<= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+uint16_t crc16_slicing8(uint16_t crc, const unsigned char* data, size_t length)
+{
+    while (length >= 8)
+    {
+        crc = tables[7][data[0] ^ (crc >> 8)] ^
+              tables[6][data[1] ^ (crc & 0xFF)] ^
+              tables[5][data[2]] ^
+              tables[4][data[3]] ^
+              tables[3][data[4]] ^
+              tables[2][data[5]] ^
+              tables[1][data[6]] ^
+              tables[0][data[7]];
+
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--)
+    {
+        crc = (crc << 8) ^ tables[0][(crc >> 8) ^ *data++];
+    }
+
+    return crc;
+}
+
+#ifdef CRC16_HAVE_CLMUL
+
+/* x^n mod P, used as folding constants */
+constexpr uint64_t xpow_mod(uint32_t n)
+{
+    uint32_t r = 1;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        r <<= 1;
+        if (r & 0x10000)
+        {
+            r ^= 0x10000 | CRC16_CCITT_POLY;
+        }
+    }
+    return r;
+}
+
+constexpr uint64_t K_FOLD4_HI = xpow_mod(512 + 64);
+constexpr uint64_t K_FOLD4_LO = xpow_mod(512);
+constexpr uint64_t K_FOLD1_HI = xpow_mod(128 + 64);
+constexpr uint64_t K_FOLD1_LO = xpow_mod(128);
+
+#define CRC16_CLMUL_MIN_LEN     64
+
+__attribute__((target("pclmul,ssse3")))
+inline __m128i fold(__m128i acc, __m128i k, __m128i next)
+{
+    __m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+    __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+    return _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+}
+
+/*
+ * Message is treated as polynomial with first byte at highest degree, so every 16 byte block
+ * is byte-reversed into register. Incoming CRC register is XOR-ed into first two bytes,
+ * blocks are folded with x^n mod P constants, and folded remainder plus tail bytes are
+ * finished with zero-init table CRC, which gives the same (M * x^16) mod P.
+ */
+__attribute__((target("pclmul,ssse3")))
+uint16_t crc16_clmul(uint16_t crc, const unsigned char* data, size_t length)
+{
+    if (length < CRC16_CLMUL_MIN_LEN)
+    {
+        return crc16_slicing8(crc, data, length);
+    }
+
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i k4 = _mm_set_epi64x(K_FOLD4_HI, K_FOLD4_LO);
+    const __m128i k1 = _mm_set_epi64x(K_FOLD1_HI, K_FOLD1_LO);
+
+    // Incoming register goes to first two message bytes
+    unsigned char first[16];
+    __builtin_memcpy(first, data, sizeof(first));
+    first[0] ^= crc >> 8;
+    first[1] ^= crc & 0xFF;
+
+    __m128i x0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(first)), bswap);
+    __m128i x1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), bswap);
+    __m128i x2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), bswap);
+    __m128i x3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), bswap);
+    data += 64;
+    length -= 64;
+
+    // Fold by 4 blocks
+    while (length >= 64)
+    {
+        x0 = fold(x0, k4, _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), bswap));
+        x1 = fold(x1, k4, _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), bswap));
+        x2 = fold(x2, k4, _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), bswap));
+        x3 = fold(x3, k4, _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), bswap));
+        data += 64;
+        length -= 64;
+    }
+
+    // Fold 4 accumulators into one
+    __m128i acc = fold(x0, k1, x1);
+    acc = fold(acc, k1, x2);
+    acc = fold(acc, k1, x3);
+
+    // Fold by 1 block
+    while (length >= 16)
+    {
+        acc = fold(acc, k1, _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), bswap));
+        data += 16;
+        length -= 16;
+    }
+
+    // Remainder back in message byte order
+    unsigned char rest[16];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(rest), _mm_shuffle_epi8(acc, bswap));
+
+    uint16_t result = crc16_slicing8(0, rest, sizeof(rest));
+    return crc16_slicing8(result, data, length);
+}
+
+bool cpu_has_clmul()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+        return false;
+    }
+    return (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+}
+
+#endif
+
+crc16_engine select_engine()
+{
+#ifdef CRC16_HAVE_CLMUL
+    if (cpu_has_clmul())
+    {
+        return CRC16_ENGINE_CLMUL;
+    }
+#endif
+    return CRC16_ENGINE_SLICING8;
+}
+
+const crc16_engine selected_engine = select_engine();
+
+}
+
+uint16_t crc16_update_with(crc16_engine engine, uint16_t crc, const unsigned char* data, size_t length)
+{
+    switch (engine)
+    {
+        case CRC16_ENGINE_BITWISE:
+            return crc16_bitwise(crc, data, length);
+#ifdef CRC16_HAVE_CLMUL
+        case CRC16_ENGINE_CLMUL:
+            // Support was checked once at startup, cpuid serializes and must stay off this path
+            if (selected_engine == CRC16_ENGINE_CLMUL)
+            {
+                return crc16_clmul(crc, data, length);
+            }
+            return crc16_slicing8(crc, data, length);
+#endif
+        default:
+            return crc16_slicing8(crc, data, length);
+    }
+}
+
+uint16_t crc16_update(uint16_t crc, const unsigned char* data, size_t length)
+{
+#ifdef CRC16_HAVE_CLMUL
+    if (selected_engine == CRC16_ENGINE_CLMUL)
+    {
+        return crc16_clmul(crc, data, length);
+    }
+#endif
+    return crc16_slicing8(crc, data, length);
+}
+
+crc16_engine crc16_selected_engine()
+{
+    return selected_engine;
+}
+
+bool crc16_engine_supported(crc16_engine engine)
+{
+    switch (engine)
+    {
+        case CRC16_ENGINE_BITWISE:
+        case CRC16_ENGINE_SLICING8:
+            return true;
+#ifdef CRC16_HAVE_CLMUL
+        case CRC16_ENGINE_CLMUL:
+            return selected_engine == CRC16_ENGINE_CLMUL;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* crc16_engine_name(crc16_engine engine)
+{
+    switch (engine)
+    {
+        case CRC16_ENGINE_BITWISE:
+            return "bitwise";
+        case CRC16_ENGINE_SLICING8:
+            return "slicing-by-8";
+        case CRC16_ENGINE_CLMUL:
+            return "clmul";
+        default:
+            return "unknown";
+    }
+}
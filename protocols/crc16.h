@@ -0,0 +1,44 @@
+/*
+ * crc16 — CRC16-CCITT (poly 0x1021, MSB first, no reflection) Engine
+ *
+ * Variants:
+ *    1) Bitwise - reference implementation, eight branches per byte
+ *    2) Slicing-by-8 - table driven, eight bytes per step
+ *    3) CLMUL - PCLMULQDQ folding of 64 byte blocks, tail finished with slicing-by-8
+ *
+ * Fastest supported variant is selected once at runtime using CPUID,
+ * all variants give bit-identical results.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#define CRC16_CCITT_POLY        0x1021
+#define CRC16_CCITT_INIT        0xFFFF
+
+enum crc16_engine {
+    CRC16_ENGINE_BITWISE,
+    CRC16_ENGINE_SLICING8,
+    CRC16_ENGINE_CLMUL
+};
+
+/* Continue CRC over data with previous register value */
+uint16_t crc16_update(uint16_t crc, const unsigned char* data, size_t length);
+
+/* Same, using exact variant (for benchmarking and verification) */
+uint16_t crc16_update_with(crc16_engine engine, uint16_t crc, const unsigned char* data, size_t length);
+
+/* Streaming context, checksums scattered pieces in place */
+struct crc16_ctx {
+    uint16_t crc = CRC16_CCITT_INIT;
+
+    void init() { crc = CRC16_CCITT_INIT; }
+    void update(const void* data, size_t length) { crc = crc16_update(crc, static_cast<const unsigned char*>(data), length); }
+    [[nodiscard]] uint16_t final() const { return crc; }
+};
+
+crc16_engine crc16_selected_engine();
+bool crc16_engine_supported(crc16_engine engine);
+const char* crc16_engine_name(crc16_engine engine);
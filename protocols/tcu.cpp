@@ -6,208 +6,159 @@
 
 tcu_packet::tcu_packet() : payload(nullptr) {}
 
-tcu_packet::tcu_packet(const tcu_packet& other)
+tcu_packet::tcu_packet(const tcu_packet_view& view) : payload(nullptr)
 {
-    header = other.header;
-    if (other.payload != nullptr && header.length > 0)
-    {
-        payload = new unsigned char[header.length];
-        std::memcpy(payload, other.payload, header.length);
-    }
-    else
+    header = view.header;
+    if (view.payload != nullptr && header.length > 0)
     {
-        payload = nullptr;
+        alloc_payload(header.length);
+        std::memcpy(payload, view.payload, header.length);
     }
 }
 
-tcu_packet& tcu_packet::operator=(const tcu_packet& other)
+tcu_packet::tcu_packet(tcu_packet&& other) noexcept : header(other.header), payload(other.payload), buffer(std::move(other.buffer))
 {
-    if (this == &other)
-        return *this;
-
-    if (payload != nullptr)
-    {
-        delete[] payload;
-        payload = nullptr;
-    }
-
-    header = other.header;
-    if (other.payload != nullptr && header.length > 0)
-    {
-        payload = new unsigned char[header.length];
-        std::memcpy(payload, other.payload, header.length);
-    }
-    else
-    {
-        payload = nullptr;
-    }
-
-    return *this;
-}
-
-tcu_packet::tcu_packet(tcu_packet&& other) noexcept {
-    header = other.header;
-    payload = other.payload;
     other.payload = nullptr;
 }
 
-tcu_packet& tcu_packet::operator=(tcu_packet&& other) noexcept {
+tcu_packet& tcu_packet::operator=(tcu_packet&& other) noexcept
+{
     if (this == &other)
     {
         return *this;
     }
 
-    if (payload != nullptr)
-    {
-        delete[] payload;
-    }
-
     header = other.header;
     payload = other.payload;
+    buffer = std::move(other.buffer);
     other.payload = nullptr;
 
     return *this;
 }
 
-tcu_packet::~tcu_packet()
+tcu_packet::~tcu_packet() = default;
+
+unsigned char* tcu_packet::alloc_payload(size_t length)
 {
-    if (payload != nullptr)
-    {
-        delete[] payload;
-        payload = nullptr;
-    }
+    buffer = PoolBuffer::allocate(length);
+    payload = buffer.data();
+    return payload;
 }
 
-unsigned char* tcu_packet::to_buff()
+void tcu_packet::write_header(unsigned char* buff) const
 {
-    size_t total_size = sizeof(tcu_header) + header.length;
-
-    auto* buffer = new unsigned char[total_size];
     size_t offset = 0;
 
     // Sequence Number (3 bytes)
     uint24_t seq_number_net = hton24(header.seq_number);
-    std::memcpy(buffer + offset, &seq_number_net, sizeof(seq_number_net));
+    std::memcpy(buff + offset, &seq_number_net, sizeof(seq_number_net));
     offset += sizeof(seq_number_net);
 
     // Flags (1 byte)
     uint8_t flags_net = header.flags;
-    std::memcpy(buffer + offset, &flags_net, sizeof(flags_net));
+    std::memcpy(buff + offset, &flags_net, sizeof(flags_net));
     offset += sizeof(flags_net);
 
     // Length (2 bytes)
     uint16_t length_net = htons(header.length);
-    std::memcpy(buffer + offset, &length_net, sizeof(length_net));
+    std::memcpy(buff + offset, &length_net, sizeof(length_net));
     offset += sizeof(length_net);
 
     // Checksum (2 bytes)
     uint16_t checksum_net = htons(header.checksum);
-    std::memcpy(buffer + offset, &checksum_net, sizeof(checksum_net));
-    offset += sizeof(checksum_net);
-
-    // Payload
-    std::memcpy(buffer + offset, payload, header.length);
-
-    return buffer;
+    std::memcpy(buff + offset, &checksum_net, sizeof(checksum_net));
 }
 
-tcu_packet tcu_packet::from_buff(unsigned char* buff)
+bool tcu_packet_view::parse(const unsigned char* buff, size_t length, tcu_packet_view& view)
 {
-    tcu_packet packet{};
+    if (length < TCU_HDR_LEN)
+    {
+        return false;
+    }
 
     size_t offset = 0;
 
     // Sequence Number (3 bytes)
     uint24_t seq_number_net;
     std::memcpy(&seq_number_net, buff + offset, sizeof(seq_number_net));
-    packet.header.seq_number = ntoh24(seq_number_net);
+    view.header.seq_number = ntoh24(seq_number_net);
     offset += sizeof(seq_number_net);
 
     // Flags (1 byte)
-    uint8_t flags_net;
-    std::memcpy(&flags_net, buff + offset, sizeof(flags_net));
-    packet.header.flags = flags_net;
-    offset += sizeof(flags_net);
+    view.header.flags = buff[offset];
+    offset += sizeof(view.header.flags);
 
     // Length (2 bytes)
     uint16_t length_net;
     std::memcpy(&length_net, buff + offset, sizeof(length_net));
-    packet.header.length = ntohs(length_net);
+    view.header.length = ntohs(length_net);
     offset += sizeof(length_net);
 
     // Checksum (2 bytes)
     uint16_t checksum_net;
     std::memcpy(&checksum_net, buff + offset, sizeof(checksum_net));
-    packet.header.checksum = ntohs(checksum_net);
+    view.header.checksum = ntohs(checksum_net);
     offset += sizeof(checksum_net);
 
-    // Payload
-    if (packet.header.length > 0)
+    // Payload stays in buffer
+    if (view.header.length > length - offset)
     {
-        packet.payload = new unsigned char[packet.header.length];
-        std::memcpy(packet.payload, buff + offset, packet.header.length);
+        return false;
     }
+    view.payload = view.header.length > 0 ? buff + offset : nullptr;
 
-    return packet;
+    return true;
 }
 
-uint16_t calculate_crc16(const unsigned char* data, size_t length)
+bool tcu_packet_view::validate_crc() const
 {
-    uint16_t crc = 0xFFFF;
-
-    for (size_t i = 0; i < length; i++)
-    {
-        crc ^= (data[i] << 8);
-
-        for (uint8_t j = 0; j < 8; j++)
-        {
-            if (crc & 0x8000)
-            {
-                crc = (crc << 1) ^ 0x1021;
-            }
-            else
-            {
-                crc <<= 1;
-            }
-        }
-    }
-    return crc;
+    return tcu_checksum(header, payload) == header.checksum;
 }
 
-void tcu_packet::calculate_crc()
+uint16_t calculate_crc16(const unsigned char* data, size_t length)
 {
-    size_t total_size = sizeof(tcu_header) - sizeof(header.checksum) + header.length;
-    auto* buffer = new unsigned char[total_size];
+    return crc16_update(CRC16_CCITT_INIT, data, length);
+}
 
-    // Copy header without CRC
-    std::memcpy(buffer, &header, sizeof(tcu_header) - sizeof(header.checksum));
+uint16_t tcu_checksum(const tcu_header& header, const unsigned char* payload)
+{
+    crc16_ctx ctx;
 
-    // Copy payload
-    std::memcpy(buffer + sizeof(tcu_header) - sizeof(header.checksum), payload, header.length);
+    // Header without CRC
+    ctx.update(&header, sizeof(tcu_header) - sizeof(header.checksum));
 
-    // Calculate CRC
-    header.checksum = calculate_crc16(buffer, total_size);
+    // Payload in place
+    ctx.update(payload, header.length);
 
-    delete[] buffer;
+    return ctx.final();
 }
 
-bool tcu_packet::validate_crc()
+uint32_t tcu_seq_unwrap(uint24_t seq, uint32_t reference)
 {
-    size_t total_size = sizeof(tcu_header) - sizeof(header.checksum) + header.length;
-    auto* buffer = new unsigned char[total_size];
-
-    // Copy header without CRC
-    std::memcpy(buffer, &header, sizeof(tcu_header) - sizeof(header.checksum));
+    uint32_t candidate = (reference & ~(TCU_SEQ_SPACE - 1)) | static_cast<uint32_t>(seq);
+    auto distance = static_cast<int32_t>(candidate - reference);
 
-    // Copy payload
-    std::memcpy(buffer + sizeof(tcu_header) - sizeof(header.checksum), payload, header.length);
+    // Within half of sequence space either way, first lap has nothing before it
+    if (distance > static_cast<int32_t>(TCU_SEQ_SPACE / 2) && candidate >= TCU_SEQ_SPACE)
+    {
+        candidate -= TCU_SEQ_SPACE;
+    }
+    else if (distance <= -static_cast<int32_t>(TCU_SEQ_SPACE / 2))
+    {
+        candidate += TCU_SEQ_SPACE;
+    }
 
-    // Calculate CRC
-    uint16_t computed_crc = calculate_crc16(buffer, total_size);
+    return candidate;
+}
 
-    delete[] buffer;
+void tcu_packet::calculate_crc()
+{
+    header.checksum = tcu_checksum(header, payload);
+}
 
-    return computed_crc == header.checksum;
+bool tcu_packet::validate_crc()
+{
+    return tcu_checksum(header, payload) == header.checksum;
 }
 
 void tcu_pcb::new_phase(int new_phase)
@@ -236,3 +187,64 @@ bool tcu_pcb::is_activity_recent() const
     auto now = std::chrono::steady_clock::now();
     return (now - last) < std::chrono::seconds(TCU_ACTIVITY_ATTEMPT_COUNT * TCU_ACTIVITY_ATTEMPT_INTERVAL);
 }
+
+void tcu_rtt::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _srtt = std::chrono::microseconds(0);
+    _rttvar = std::chrono::microseconds(0);
+    _rto = std::chrono::milliseconds(TCU_RTO_INITIAL_MS);
+    _backoffs = 0;
+}
+
+void tcu_rtt::sample(std::chrono::microseconds rtt)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_srtt.count() == 0)
+    {
+        // First measurement
+        _srtt = rtt;
+        _rttvar = rtt / 2;
+    }
+    else
+    {
+        // RTTVAR first, it uses previous SRTT
+        auto delta = _srtt > rtt ? _srtt - rtt : rtt - _srtt;
+        _rttvar = (3 * _rttvar + delta) / 4;
+        _srtt = (7 * _srtt + rtt) / 8;
+    }
+
+    // Fresh sample also ends backoff
+    _rto = _srtt + std::max(std::chrono::microseconds(TCU_RTO_GRANULARITY_US), 4 * _rttvar);
+    _rto = std::clamp<std::chrono::microseconds>(_rto, std::chrono::milliseconds(TCU_RTO_MIN_MS), std::chrono::milliseconds(TCU_RTO_MAX_MS));
+    _backoffs = 0;
+}
+
+void tcu_rtt::backoff()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _rto = std::min<std::chrono::microseconds>(_rto * 2, std::chrono::milliseconds(TCU_RTO_MAX_MS));
+    _backoffs++;
+}
+
+std::chrono::microseconds tcu_rtt::rto() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _rto;
+}
+
+std::string tcu_rtt::report() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::ostringstream out;
+    out << "rtt srtt " << _srtt.count() << " us"
+        << " rttvar " << _rttvar.count() << " us"
+        << " rto " << _rto.count() << " us"
+        << " backoffs " << _backoffs;
+
+    return out.str();
+}
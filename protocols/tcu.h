@@ -25,6 +25,12 @@
  *    - Sequence number of the packet
  *    - Ensures that receiver can reassemble data, even if fragments arrive out of order
  *    - When message is fragmented, each fragment has its own sequence number
+ *    - Fragments are numbered from 1 in 32 bits, header carries low 24 bits, so long
+ *      messages wrap sequence space; receiver restores full number as one nearest to
+ *      next expected fragment (serial number arithmetic, RFC 1982), which is exact
+ *      while fewer than 2^23 fragments are in flight
+ *    - Numbering restarts at 1 on connect and runs across messages, single message takes
+ *      one number too, so late copies of earlier message fall below next expected fragment
  *
  * 2. Flags:
  *    - Control flags that are used to indicate the packet's state:
@@ -48,6 +54,8 @@
  * Selective Repeat (SR) Support:
  *    - The TCU protocol employs Selective Repeat (SR) with Dynamic Window ARQ to ensure reliable data transmission
  *    - SR allows retransmission of only corrupted or lost fragments based on the NACK packets
+ *    - Lost fragments asking for acknowledgment, and lost acknowledgments, are recovered
+ *      by retransmission timeout derived from measured round trip time
  *
  * Flags Combinations :
  * 1. Connection Request — SYN, LEN 0
@@ -56,8 +64,8 @@
  * 3. Disconnection Request — FIN, LEN 0
  * 4. Disconnection Acknowledgment — FIN + ACK, LEN 0
  *
- * 5. Keep-Alive Request — KA, LEN 0
- * 6. Keep-Alive Acknowledgment — KA + ACK, LEN 0
+ * 5. Keep-Alive Request — KA, LEN 0 (LEN > 0 is path probe)
+ * 6. Keep-Alive Acknowledgment — KA + ACK, LEN 0 (LEN 2 answers path probe)
  *
  * 7. Single Message — DF, LEN
  * 8. Fragment of Message — MF, LEN
@@ -68,9 +76,31 @@
  * 12. Fragment of File — MF + FL, LEN
  * 13. Last Window Fragment of File — MF + FIN + FL, LEN
  * 14. Last Fragment of File — FL, LEN
+ *     - File message starts with name length (1 byte), name and file size (8 bytes, big endian)
+ *     - Fragmented message (8-10, 12-14) ends with CRC16 of all message bytes before it (2 bytes, big endian),
+ *       receiver discards message when it does not match
  *
- * 15. Acknowledgment - ACK, LEN 0, SEQ NUM
- * 16. Negative Acknowledgment — NACK, LEN 0, SEQ NUM [ERR FRG]
+ * 15. Acknowledgment - ACK, LEN 3, SEQ NUM, WND
+ * 16. Negative Acknowledgment — NACK, LEN 3 + BITMAP, SEQ NUM [ERR FRG], WND, BITMAP
+ *
+ * Path MTU Discovery:
+ *    - Keep-Alive Request with LEN > 0 is path probe, payload is padding and IP header has DF set
+ *    - Receiver answers Keep-Alive Acknowledgment with LEN 2 carrying probed LEN
+ *    - Sender searches between Ethernet payload (always assumed to pass) and largest UDP datagram,
+ *      size is too big when sending fails locally or TCU_PMTU_PROBE_COUNT probes go unanswered
+ *    - Largest answered size becomes fragment size
+ *
+ * Flow Control:
+ *    - ACK and NACK carry receiver window (WND, 3 bytes) as payload
+ *    - Window is number of fragments sender may have past acknowledged one,
+ *      derived from receiver free reorder buffer budget and socket receive buffer
+ *    - Acknowledgments with LEN 0 carry no window and leave sender limit unchanged
+ *
+ * Selective Negative Acknowledgment:
+ *    - SEQ NUM of NACK is first missing fragment, every fragment before it was received
+ *    - Bitmap after WND marks further missing fragments, bit i (LSB first) is fragment SEQ NUM + 1 + i
+ *    - Bitmap covers up to 8 * 128 fragments and is trimmed after last set byte
+ *    - Sender resends all reported fragments at once, highest one carries FIN to ask for new report
  */
 
 #pragma once
@@ -83,8 +113,13 @@
 #include <chrono>
 #include <spdlog/spdlog.h>
 #include <map>
+#include <mutex>
+#include <string>
+#include <sstream>
 
 #include "../types/uint24_t.h"
+#include "crc16.h"
+#include "../tools/buffer_pool.h"
 
 #define TCU_PHASE_DEAD          0
 #define TCU_PHASE_HOLDOFF       1
@@ -110,6 +145,10 @@
 #define TCU_HDR_LEN             8
 #define TCU_MAX_PAYLOAD_LEN     (ETH2_MAX_PAYLOAD_LEN - IPV4_HDR_LEN - UDP_HDR_LEN - TCU_HDR_LEN)
 
+#define UDP_MAX_PAYLOAD_LEN     65507   // Largest datagram over IPv4
+#define TCU_MAX_PROBE_LEN       (UDP_MAX_PAYLOAD_LEN - TCU_HDR_LEN)     // Largest fragment path probing may confirm
+#define TCU_PMTU_PROBE_COUNT    3       // Lost probes of one size before it is taken as too big
+
 #define TCU_ACTIVITY_TIMEOUT_INTERVAL   300     // 5 minutes (300 seconds) without activities
 #define TCU_ACTIVITY_ATTEMPT_COUNT      3       // Number of attempts
 #define TCU_ACTIVITY_ATTEMPT_INTERVAL   5       // 5 second interval between attempts
@@ -117,6 +156,25 @@
 #define TCU_CONFIRM_TIMEOUT_INTERVAL    5       // 5 seconds to get conn ack
 #define TCU_RECEIVE_TIMEOUT_INTERVAL    60      // 1 minute (60 seconds) to get window ack
 
+#define TCU_WINDOWS_IN_FLIGHT           4       // Windows sent ahead of oldest unacknowledged fragment
+#define TCU_RETRANSMIT_BUFFER_LEN       4096    // Maximum fragments kept for retransmission
+
+#define TCU_RTO_INITIAL_MS              1000    // Retransmission timeout before first round trip sample
+#define TCU_RTO_MIN_MS                  20      // Lower bound, LAN tail loss recovers within milliseconds
+#define TCU_RTO_MAX_MS                  60000   // Upper bound for exponential backoff
+#define TCU_RTO_GRANULARITY_US          1000    // Clock granularity term G
+
+#define TCU_RECEIVE_BUFFER_LEN          (16 * 1024 * 1024)  // Receiver budget for out-of-order fragments
+#define TCU_REORDER_BUFFER_LEN          16384               // Fragments ahead of first gap the receiver can hold
+#define TCU_MAX_WINDOW                  0xFFFFFF            // Largest advertised window
+
+#define TCU_SEQ_SPACE                   (1u << 24)          // Sequence numbers on wire, fragments wrap past it
+#define TCU_MAX_FRAGMENTS               0xFFFFFFFEu         // Fragments numbered on one connection, 32 bits
+#define TCU_MESSAGE_CRC_LEN             2                   // End-to-end checksum closing fragmented message
+
+#define TCU_NACK_BITMAP_LEN             128                         // Bytes of missing fragments bitmap
+#define TCU_NACK_MAX_FRAGMENTS          (TCU_NACK_BITMAP_LEN * 8 + 1)
+
 struct tcu_header {
     uint24_t seq_number;        // Sequence packet number
     uint8_t flags;              // Flags
@@ -124,27 +182,62 @@ struct tcu_header {
     uint16_t checksum;          // CRC sum
 };
 
+/* Non-owning TCU packet, payload points into receive buffer */
+struct tcu_packet_view {
+    tcu_header header{};
+    const unsigned char* payload = nullptr;
+
+    static bool parse(const unsigned char* buff, size_t length, tcu_packet_view& view);
+
+    [[nodiscard]] bool validate_crc() const;
+};
+
 struct tcu_packet {
     tcu_header header{};
-    unsigned char* payload;
+    unsigned char* payload;     // Points into buffer
+    PoolBuffer buffer;
 
     tcu_packet();
     ~tcu_packet();
 
-    tcu_packet(const tcu_packet& other);
-    tcu_packet& operator=(const tcu_packet& other);
+    unsigned char* alloc_payload(size_t length);         // Pooled payload storage
+
+    explicit tcu_packet(const tcu_packet_view& view);    // Single copy of borrowed payload
+
+    /* Move only, payload is never duplicated */
+    tcu_packet(const tcu_packet& other) = delete;
+    tcu_packet& operator=(const tcu_packet& other) = delete;
 
     tcu_packet(tcu_packet&& other) noexcept;
     tcu_packet& operator=(tcu_packet&& other) noexcept;
 
-    unsigned char* to_buff();
-    static tcu_packet from_buff(unsigned char* buff);
+    void write_header(unsigned char* buff) const;   // Writes TCU_HDR_LEN bytes in network order
 
     void calculate_crc();
     bool validate_crc() ;
 };
 
 uint16_t calculate_crc16(const unsigned char* data, size_t length);   // CRC16-CCITT algorithm
+uint16_t tcu_checksum(const tcu_header& header, const unsigned char* payload);  // Header without CRC and payload
+
+uint32_t tcu_seq_unwrap(uint24_t seq, uint32_t reference);          // Fragment number nearest to reference with these low 24 bits
+
+/* Round trip estimation and retransmission timeout (RFC 6298) */
+struct tcu_rtt {
+    void reset();
+    void sample(std::chrono::microseconds rtt);     // Only from fragments sent once (Karn)
+    void backoff();                                 // Timer expired, doubles timeout
+
+    std::chrono::microseconds rto() const;
+    std::string report() const;
+
+private:
+    std::chrono::microseconds _srtt{0};
+    std::chrono::microseconds _rttvar{0};
+    std::chrono::microseconds _rto{TCU_RTO_INITIAL_MS * 1000};
+    int _backoffs = 0;
+    mutable std::mutex _mutex;
+};
 
 /* TCU PCB (Protocol Control Block) */
 struct tcu_pcb {
@@ -167,4 +260,7 @@ struct tcu_pcb {
     void update_last_activity();
     bool is_activity_recent() const;
 
+    /* Retransmission params */
+    tcu_rtt rtt;
+
 };
\ No newline at end of file
@@ -0,0 +1,581 @@
+/*
+ * bench.cpp
+ */
+
+#include "bench.h"
+
+namespace {
+
+enum io_mode {
+    IO_SINGLE,          // sendto, select + recvfrom
+    IO_BATCH,           // sendmmsg, recvmmsg
+    IO_SEGMENTED,       // UDP_SEGMENT sendmsg, UDP_GRO recvmsg
+    IO_URING            // Linked sendmsg chain, multishot recvmsg
+};
+
+struct reorder_result {
+    double ns_per_fragment;
+    size_t consumed;        // Payload bytes delivered in order
+    size_t missing;         // Holes reported by all bitmap scans
+};
+
+struct peers_result {
+    double seconds;
+    size_t delivered;       // Peers whose message was acknowledged
+};
+
+struct io_result {
+    double tx_pps;
+    size_t sent;
+    double rx_pps;
+    size_t received;
+};
+
+/* Loopback run, single mode mirrors node per-datagram path */
+io_result run_io(io_mode mode, size_t batch_size, size_t count)
+{
+    Socket receiver(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    Socket sender(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+    int buff_size = 3000000;
+    setsockopt(receiver.get_socket(), SOL_SOCKET, SO_RCVBUF, &buff_size, sizeof(buff_size));
+    setsockopt(sender.get_socket(), SOL_SOCKET, SO_SNDBUF, &buff_size, sizeof(buff_size));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+
+    socklen_t addr_len = sizeof(addr);
+    if (bind(receiver.get_socket(), reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        getsockname(receiver.get_socket(), reinterpret_cast<sockaddr*>(&addr), &addr_len) < 0 ||
+        receiver.set_non_blocking() < 0)
+    {
+        perror("bench socket");
+        return {};
+    }
+
+    if (mode == IO_SEGMENTED && (!sender.gso_supported() || !receiver.set_gro(true)))
+    {
+        std::cout << "  segmentation offload not supported" << std::endl;
+        return {};
+    }
+
+    if (mode == IO_URING && (!sender.set_uring(true) || !receiver.set_uring(true)))
+    {
+        std::cout << "  io_uring not supported" << std::endl;
+        return {};
+    }
+
+    // Completions become readable on ring descriptor instead of socket
+    int wait_fd = mode == IO_URING ? receiver.get_uring() : receiver.get_socket();
+
+    std::atomic<size_t> received{0};
+    std::chrono::steady_clock::time_point rx_first, rx_last;
+
+    std::thread receive_thread([&]() {
+        ReceiveBatch batch(SOCKET_MAX_BATCH, SOCKET_RECV_BUFF_LEN);
+        std::vector<unsigned char> buff(SOCKET_GRO_BUFF_LEN);
+        auto last_data = std::chrono::steady_clock::now();
+
+        while (std::chrono::steady_clock::now() - last_data < std::chrono::milliseconds(BENCH_IO_IDLE_MS))
+        {
+            fd_set read_fds;
+            FD_ZERO(&read_fds);
+            FD_SET(wait_fd, &read_fds);
+            struct timeval timeout{0, 50000};
+
+            if (select(wait_fd + 1, &read_fds, nullptr, nullptr, &timeout) <= 0)
+            {
+                continue;
+            }
+
+            size_t got = 0;
+            if (mode == IO_SINGLE)
+            {
+                got = recvfrom(receiver.get_socket(), buff.data(), SOCKET_RECV_BUFF_LEN, 0, nullptr, nullptr) > 0 ? 1 : 0;
+            }
+            else if (mode == IO_SEGMENTED)
+            {
+                sockaddr_in src_addr{};
+                uint16_t segment_size;
+                ssize_t result;
+                while ((result = receiver.receive_segmented(buff.data(), buff.size(), src_addr, segment_size)) > 0)
+                {
+                    got += segment_size > 0 ? (result + segment_size - 1) / segment_size : 1;
+                }
+            }
+            else if (mode == IO_URING)
+            {
+                got = receiver.receive_uring([](const unsigned char*, size_t, const sockaddr_in&) {});
+            }
+            else
+            {
+                int result;
+                while ((result = receiver.receive_batch(batch, batch_size)) > 0)
+                {
+                    got += result;
+                    if (static_cast<size_t>(result) < batch_size)
+                    {
+                        break;
+                    }
+                }
+            }
+
+            if (got > 0)
+            {
+                last_data = std::chrono::steady_clock::now();
+                if (received == 0)
+                {
+                    rx_first = last_data;
+                }
+                rx_last = last_data;
+                received += got;
+            }
+        }
+    });
+
+    unsigned char payload[TCU_HDR_LEN + TCU_MAX_PAYLOAD_LEN] = {};
+    size_t max_segments = std::min<size_t>(SOCKET_GSO_MAX_SEGMENTS, SOCKET_GSO_MAX_BYTES / sizeof(payload));
+    struct iovec iov[SOCKET_MAX_BATCH];
+    struct mmsghdr msgs[SOCKET_MAX_BATCH];
+    for (size_t i = 0; i < SOCKET_MAX_BATCH; i++)
+    {
+        iov[i] = {payload, sizeof(payload)};
+        msgs[i] = {};
+        msgs[i].msg_hdr.msg_name = &addr;
+        msgs[i].msg_hdr.msg_namelen = sizeof(addr);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // Only datagrams kernel accepted are counted, failed send ends run early
+    size_t sent = 0;
+    auto tx_start = std::chrono::steady_clock::now();
+    while (sent < count)
+    {
+        ssize_t accepted = -1;
+        if (mode == IO_SINGLE)
+        {
+            accepted = sendto(sender.get_socket(), payload, sizeof(payload), 0, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ? -1 : 1;
+        }
+        else if (mode == IO_SEGMENTED)
+        {
+            size_t chunk = std::min(max_segments, count - sent);
+            accepted = sender.send_segmented(addr, iov, chunk, sizeof(payload)) < 0 ? -1 : static_cast<ssize_t>(chunk);
+        }
+        else
+        {
+            size_t chunk = std::min(batch_size, count - sent);
+            accepted = sender.send_batch(msgs, chunk);
+        }
+
+        if (accepted <= 0)
+        {
+            perror("bench send");
+            break;
+        }
+        sent += static_cast<size_t>(accepted);
+    }
+    auto tx_end = std::chrono::steady_clock::now();
+
+    receive_thread.join();
+
+    io_result result{};
+    result.tx_pps = static_cast<double>(sent) / std::chrono::duration<double>(tx_end - tx_start).count();
+    result.sent = sent;
+    result.received = received;
+    double rx_seconds = std::chrono::duration<double>(rx_last - rx_first).count();
+    result.rx_pps = rx_seconds > 0 ? static_cast<double>(received) / rx_seconds : 0.0;
+
+    return result;
+}
+
+/* Arrival order with lost fragments retransmitted later */
+std::vector<uint32_t> reorder_arrivals(size_t count)
+{
+    std::mt19937 gen(42);
+    std::bernoulli_distribution lost(BENCH_REORDER_LOSS);
+
+    std::vector<uint32_t> arrivals;
+    std::vector<std::pair<size_t, uint32_t>> late;
+    arrivals.reserve(count);
+
+    for (uint32_t seq = 1; seq <= count; seq++)
+    {
+        if (lost(gen))
+        {
+            late.emplace_back(arrivals.size() + BENCH_REORDER_DELAY, seq);
+        }
+        else
+        {
+            arrivals.push_back(seq);
+        }
+
+        while (!late.empty() && late.front().first <= arrivals.size())
+        {
+            arrivals.push_back(late.front().second);
+            late.erase(late.begin());
+        }
+    }
+
+    for (auto& [position, seq] : late)
+    {
+        arrivals.push_back(seq);
+    }
+
+    return arrivals;
+}
+
+/* Receive path as in Node::store_fragment over ordered map, ns per fragment */
+reorder_result run_reorder_map(const std::vector<uint32_t>& arrivals, const unsigned char* payload)
+{
+    std::map<uint32_t, tcu_packet> packets;
+    uint32_t next = 1;
+    size_t missing = 0;
+    size_t consumed = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < arrivals.size(); i++)
+    {
+        tcu_packet_view view;
+        view.header.seq_number = arrivals[i];
+        view.header.length = TCU_MAX_PAYLOAD_LEN;
+        view.payload = payload;
+
+        uint32_t seq = arrivals[i];
+        if (seq < next || packets.count(seq) > 0)
+        {
+            continue;
+        }
+
+        if (seq != next)
+        {
+            packets.emplace(seq, tcu_packet(view));
+        }
+        else
+        {
+            consumed += view.header.length;
+            next++;
+
+            auto it = packets.begin();
+            while (it != packets.end() && it->first == next)
+            {
+                consumed += it->second.header.length;
+                next++;
+                it = packets.erase(it);
+            }
+        }
+
+        // Negative acknowledgment bitmap, one lookup per fragment
+        if (i % BENCH_REORDER_NACK == 0 && !packets.empty())
+        {
+            uint32_t last = std::min<uint32_t>(packets.rbegin()->first, next + TCU_NACK_BITMAP_LEN * 8);
+            for (uint32_t scan = next + 1; scan <= last; scan++)
+            {
+                missing += packets.count(scan) == 0;
+            }
+        }
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end_time - start_time).count() / static_cast<double>(arrivals.size());
+
+    return {ns, consumed, missing};
+}
+
+/* Same receive path over sequence ring, ns per fragment */
+reorder_result run_reorder_ring(const std::vector<uint32_t>& arrivals, const unsigned char* payload)
+{
+    seq_ring<tcu_packet> packets(TCU_REORDER_BUFFER_LEN);
+    uint32_t highest = 0;
+    size_t missing = 0;
+    size_t consumed = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < arrivals.size(); i++)
+    {
+        tcu_packet_view view;
+        view.header.seq_number = arrivals[i];
+        view.header.length = TCU_MAX_PAYLOAD_LEN;
+        view.payload = payload;
+
+        uint32_t seq = arrivals[i];
+        if (seq < packets.base() || packets.contains(seq) || !packets.in_range(seq))
+        {
+            continue;
+        }
+
+        if (seq != packets.base())
+        {
+            packets.insert(seq, tcu_packet(view));
+            highest = std::max(highest, seq);
+        }
+        else
+        {
+            consumed += view.header.length;
+            packets.release_until(seq, [](uint32_t, tcu_packet&) {});
+            packets.drain([&](uint32_t, tcu_packet& stored) { consumed += stored.header.length; });
+        }
+
+        // Negative acknowledgment bitmap, one bitmap word per 64 fragments
+        if (i % BENCH_REORDER_NACK == 0 && !packets.empty())
+        {
+            uint32_t last = std::min<uint32_t>(highest, packets.base() + TCU_NACK_BITMAP_LEN * 8);
+            packets.for_each_missing(packets.base() + 1, last, [&](uint32_t) { missing++; });
+        }
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end_time - start_time).count() / static_cast<double>(arrivals.size());
+
+    return {ns, consumed, missing};
+}
+
+/* Every peer is own host on loopback, all send to one accepting host at once */
+peers_result run_peers(size_t count, const std::string& message)
+{
+    in_addr loopback{htonl(INADDR_LOOPBACK)};
+
+    std::vector<std::unique_ptr<Host>> clients;
+    std::vector<Node*> nodes;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        clients.push_back(std::make_unique<Host>());
+        clients.back()->set_port(static_cast<uint16_t>(BENCH_PEERS_PORT + 1 + i));
+
+        Node* node = clients.back()->select_peer(loopback, BENCH_PEERS_PORT);
+        node->set_path_probing(false);
+        node->send_tcu_conn_req();
+        nodes.push_back(node);
+    }
+
+    std::atomic<bool> go{false};
+    std::vector<std::thread> senders;
+    for (Node* node : nodes)
+    {
+        senders.emplace_back([&go, node, &message]() {
+            while (!go.load(std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            node->send_text(message);
+        });
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (auto& sender : senders)
+    {
+        sender.join();
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+
+    // Failed transfer leaves network phase
+    size_t delivered = 0;
+    for (Node* node : nodes)
+    {
+        if (node->get_pcb().phase == TCU_PHASE_NETWORK)
+        {
+            delivered++;
+        }
+        node->send_tcu_disconn_req();
+    }
+
+    return {std::chrono::duration<double>(end_time - start_time).count(), delivered};
+}
+
+}
+
+void Bench::crc()
+{
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 255);
+
+    std::vector<unsigned char> data(4 * TCU_MAX_PAYLOAD_LEN);
+    for (auto& byte : data)
+    {
+        byte = static_cast<unsigned char>(dist(gen));
+    }
+
+    const crc16_engine engines[] = {CRC16_ENGINE_BITWISE, CRC16_ENGINE_SLICING8, CRC16_ENGINE_CLMUL};
+
+    // Verification against reference on every length and unaligned start
+    for (crc16_engine engine : engines)
+    {
+        if (!crc16_engine_supported(engine))
+        {
+            continue;
+        }
+
+        for (size_t offset = 0; offset < 8; offset++)
+        {
+            for (size_t length = 0; length + offset <= data.size(); length += (length < 256 ? 1 : 61))
+            {
+                // Odd lengths continue from arbitrary register value
+                uint16_t seed = (length & 1) ? static_cast<uint16_t>(length * 40503) : CRC16_CCITT_INIT;
+
+                uint16_t expected = crc16_update_with(CRC16_ENGINE_BITWISE, seed, data.data() + offset, length);
+                uint16_t actual = crc16_update_with(engine, seed, data.data() + offset, length);
+
+                if (expected != actual)
+                {
+                    std::cout << "crc16 " << crc16_engine_name(engine) << " mismatch at length " << length << " offset " << offset << std::endl;
+                    return;
+                }
+            }
+        }
+    }
+
+    std::cout << "crc16 variants verified, selected " << crc16_engine_name(crc16_selected_engine()) << std::endl;
+
+    // Throughput at full fragment size
+    const size_t length = TCU_MAX_PAYLOAD_LEN;
+
+    for (crc16_engine engine : engines)
+    {
+        if (!crc16_engine_supported(engine))
+        {
+            std::cout << "  " << crc16_engine_name(engine) << " not supported" << std::endl;
+            continue;
+        }
+
+        volatile uint16_t sink = 0;
+        size_t iterations = 0;
+
+        auto start_time = std::chrono::steady_clock::now();
+        auto end_time = start_time;
+        while (end_time - start_time < std::chrono::milliseconds(BENCH_MIN_DURATION_MS))
+        {
+            for (int i = 0; i < 1000; i++)
+            {
+                sink = sink ^ crc16_update_with(engine, CRC16_CCITT_INIT, data.data() + (i & 7), length);
+            }
+            iterations += 1000;
+            end_time = std::chrono::steady_clock::now();
+        }
+
+        double seconds = std::chrono::duration<double>(end_time - start_time).count();
+        double gbps = static_cast<double>(iterations * length) / seconds / 1e9;
+
+        std::cout << "  " << crc16_engine_name(engine) << " " << length << " bytes " << gbps << " GB/s" << std::endl;
+    }
+}
+
+void Bench::io(size_t batch_size)
+{
+    if (batch_size < 2 || batch_size > SOCKET_MAX_BATCH)
+    {
+        std::cout << "invalid batch size" << std::endl;
+        return;
+    }
+
+    std::cout << "loopback " << BENCH_IO_PACKETS << " datagrams of " << TCU_HDR_LEN + TCU_MAX_PAYLOAD_LEN << " bytes" << std::endl;
+
+    const io_mode modes[] = {IO_SINGLE, IO_BATCH, IO_SEGMENTED, IO_URING};
+    const char* names[] = {"sendto/recvfrom", "sendmmsg/recvmmsg", "gso/gro", "io_uring"};
+
+    for (io_mode mode : modes)
+    {
+        io_result result = run_io(mode, batch_size, BENCH_IO_PACKETS);
+
+        std::cout << "  " << names[mode] << (mode == IO_BATCH || mode == IO_URING ? " batch " + std::to_string(batch_size) : "")
+                  << " tx " << static_cast<uint64_t>(result.tx_pps) << " pps"
+                  << " rx " << static_cast<uint64_t>(result.rx_pps) << " pps"
+                  << " received " << result.received << "/" << BENCH_IO_PACKETS
+                  << (result.sent < BENCH_IO_PACKETS ? " sent " + std::to_string(result.sent) : "") << std::endl;
+    }
+}
+
+void Bench::reorder()
+{
+    std::vector<uint32_t> arrivals = reorder_arrivals(BENCH_REORDER_PACKETS);
+    std::vector<unsigned char> payload(TCU_MAX_PAYLOAD_LEN, 0xA5);
+
+    std::cout << "receive path " << BENCH_REORDER_PACKETS << " fragments of " << TCU_MAX_PAYLOAD_LEN << " bytes, "
+              << BENCH_REORDER_LOSS * 100 << "% retransmitted " << BENCH_REORDER_DELAY << " arrivals late" << std::endl;
+
+    reorder_result map = run_reorder_map(arrivals, payload.data());
+    reorder_result ring = run_reorder_ring(arrivals, payload.data());
+
+    // Both buffers must deliver whole stream and see same holes
+    if (map.consumed != ring.consumed || map.missing != ring.missing || ring.consumed != BENCH_REORDER_PACKETS * TCU_MAX_PAYLOAD_LEN)
+    {
+        std::cout << "reorder buffers mismatch, consumed " << map.consumed << " and " << ring.consumed
+                  << " bytes, missing " << map.missing << " and " << ring.missing << std::endl;
+        return;
+    }
+
+    std::cout << "  std::map " << map.ns_per_fragment << " ns/fragment" << std::endl;
+    std::cout << "  seq_ring " << ring.ns_per_fragment << " ns/fragment" << std::endl;
+}
+
+void Bench::peers(size_t max_peers, size_t shards, size_t workers)
+{
+    if (max_peers < 1 || max_peers > HOST_MAX_PEERS)
+    {
+        std::cout << "invalid peer count" << std::endl;
+        return;
+    }
+
+    if (shards < 1 || shards > HOST_MAX_SHARDS)
+    {
+        std::cout << "invalid shard count" << std::endl;
+        return;
+    }
+
+    if (workers > EXECUTOR_MAX_WORKERS)
+    {
+        std::cout << "invalid worker count" << std::endl;
+        return;
+    }
+
+    std::string message(BENCH_PEERS_BYTES, 'x');
+
+    std::cout << "loopback " << BENCH_PEERS_BYTES << " bytes text per peer, " << TCU_MAX_PAYLOAD_LEN << " byte fragments, one accepting host with "
+              << shards << " receive shards and " << workers << " workers, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+    // Protocol logging and per-message output would dominate measurement
+    auto level = spdlog::get_level();
+    spdlog::set_level(spdlog::level::err);
+
+    // Server keeps its table between runs, reconnecting peers reuse their entries
+    Host server;
+    server.get_selected()->set_path_probing(false);
+    server.set_shards(shards);
+    server.set_workers(workers);
+    server.set_port(BENCH_PEERS_PORT);
+
+    // Doubling peer counts, requested count last
+    std::vector<size_t> counts;
+    for (size_t count = 1; count < max_peers; count *= 2)
+    {
+        counts.push_back(count);
+    }
+    counts.push_back(max_peers);
+
+    for (size_t count : counts)
+    {
+        std::streambuf* out = std::cout.rdbuf(nullptr);
+        peers_result result = run_peers(count, message);
+        std::cout.rdbuf(out);
+        std::cout.clear();
+
+        double total = static_cast<double>(BENCH_PEERS_BYTES) * static_cast<double>(result.delivered);
+        double fragments = static_cast<double>((BENCH_PEERS_BYTES + TCU_MAX_PAYLOAD_LEN - 1) / TCU_MAX_PAYLOAD_LEN) * static_cast<double>(result.delivered);
+        std::cout << "  peers " << count
+                  << " aggregate " << static_cast<uint64_t>(total / result.seconds / 1e6) << " MB/s"
+                  << " " << static_cast<uint64_t>(fragments / result.seconds) << " pps"
+                  << " per peer " << static_cast<uint64_t>(total / result.seconds / 1e6 / static_cast<double>(count)) << " MB/s"
+                  << " delivered " << result.delivered << "/" << count
+                  << " in " << static_cast<uint64_t>(result.seconds * 1000) << " ms" << std::endl;
+    }
+
+    std::cout << server.report() << std::endl;
+    spdlog::set_level(level);
+}
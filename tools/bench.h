@@ -0,0 +1,40 @@
+/*
+ * bench.h
+ */
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <arpa/inet.h>
+#include <sys/select.h>
+
+#include "../protocols/tcu.h"
+#include "../protocols/crc16.h"
+#include "../entities/socket.h"
+#include "../entities/host.h"
+#include "../types/seq_ring.h"
+
+#define BENCH_MIN_DURATION_MS   200     // Minimum measuring time per variant
+#define BENCH_IO_PACKETS        200000  // Datagrams per socket I/O run
+#define BENCH_IO_IDLE_MS        200     // Receiver stops after this long without data
+#define BENCH_REORDER_PACKETS   1000000 // Fragments per reorder buffer run
+#define BENCH_REORDER_LOSS      0.03    // Fragments arriving late as retransmissions
+#define BENCH_REORDER_DELAY     256     // Arrivals between loss and its retransmission
+#define BENCH_REORDER_NACK      64      // Arrivals between missing fragment scans
+#define BENCH_PEERS_BYTES       (4 * 1024 * 1024)   // Text sent by every peer per run
+#define BENCH_PEERS_PORT        47000   // Accepting host, peers bind ports above it
+
+class Bench {
+public:
+    static void crc();
+    static void io(size_t batch_size);
+    static void reorder();
+    static void peers(size_t max_peers, size_t shards, size_t workers);
+};
@@ -0,0 +1,279 @@
+/*
+ * buffer_pool.cpp
+ */
+
+#include "buffer_pool.h"
+
+std::atomic<bool> BufferPool::_huge_pages{false};
+
+BufferPool::BufferPool(size_t slot_size, size_t max_chunks)
+{
+    // Round up to cache line, so every slot starts on its own line
+    _slot_size = (slot_size + POOL_CACHE_LINE - 1) / POOL_CACHE_LINE * POOL_CACHE_LINE;
+    _slots_per_chunk = POOL_CHUNK_SIZE / _slot_size;
+    _max_chunks = max_chunks;
+
+    _chunks = new std::atomic<unsigned char*>[_max_chunks];
+    for (size_t i = 0; i < _max_chunks; i++)
+    {
+        _chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+BufferPool::~BufferPool()
+{
+    size_t count = _chunk_count.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        munmap(_chunks[i].load(std::memory_order_relaxed), POOL_CHUNK_SIZE);
+    }
+
+    delete[] _chunks;
+}
+
+BufferPool* BufferPool::for_size(size_t size)
+{
+    static BufferPool small_pool(POOL_SMALL_SLOT_SIZE, POOL_MAX_CHUNKS);
+    static BufferPool large_pool(POOL_LARGE_SLOT_SIZE, POOL_MAX_CHUNKS);
+
+    if (size <= small_pool.get_slot_size())
+    {
+        return &small_pool;
+    }
+    if (size <= large_pool.get_slot_size())
+    {
+        return &large_pool;
+    }
+    return nullptr;
+}
+
+void BufferPool::set_huge_pages(bool enabled)
+{
+    _huge_pages = enabled;
+    spdlog::info("[BufferPool::set_huge_pages] huge pages {}", enabled ? "on" : "off");
+}
+
+std::string BufferPool::report_all()
+{
+    return for_size(POOL_SMALL_SLOT_SIZE)->report() + "\n" + for_size(POOL_LARGE_SLOT_SIZE)->report();
+}
+
+unsigned char* BufferPool::slot_address(uint32_t index) const
+{
+    unsigned char* chunk = _chunks[index / _slots_per_chunk].load(std::memory_order_acquire);
+    return chunk + (index % _slots_per_chunk) * _slot_size;
+}
+
+std::atomic_ref<uint32_t> BufferPool::slot_next(uint32_t index) const
+{
+    // Free slot keeps index + 1 of next free slot in its first bytes
+    return std::atomic_ref<uint32_t>(*reinterpret_cast<uint32_t*>(slot_address(index)));
+}
+
+void BufferPool::push_chain(uint32_t first, uint32_t last)
+{
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    uint64_t new_head;
+
+    do
+    {
+        slot_next(last).store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        new_head = (((head >> 32) + 1) << 32) | (first + 1);
+    }
+    while (!_head.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+}
+
+bool BufferPool::grow()
+{
+    std::lock_guard<std::mutex> lock(_grow_mutex);
+
+    // Other thread could already refill freelist
+    if (static_cast<uint32_t>(_head.load(std::memory_order_acquire)) != 0)
+    {
+        return true;
+    }
+
+    size_t count = _chunk_count.load(std::memory_order_relaxed);
+    if (count >= _max_chunks)
+    {
+        return false;
+    }
+
+    void* memory = MAP_FAILED;
+    bool huge = false;
+
+    if (_huge_pages)
+    {
+        memory = mmap(nullptr, POOL_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = memory != MAP_FAILED;
+    }
+
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(nullptr, POOL_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            spdlog::error("[BufferPool::grow] cannot map chunk for slot size {}", _slot_size);
+            return false;
+        }
+
+        if (_huge_pages)
+        {
+            // No reserved huge pages, ask for transparent ones
+            madvise(memory, POOL_CHUNK_SIZE, MADV_HUGEPAGE);
+        }
+    }
+
+    _chunks[count].store(static_cast<unsigned char*>(memory), std::memory_order_release);
+    _chunk_count.store(count + 1, std::memory_order_release);
+    if (huge)
+    {
+        _huge_chunks.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Link new slots and publish them at once
+    auto first = static_cast<uint32_t>(count * _slots_per_chunk);
+    auto last = static_cast<uint32_t>(first + _slots_per_chunk - 1);
+    for (uint32_t index = first; index < last; index++)
+    {
+        slot_next(index).store(index + 2, std::memory_order_relaxed);
+    }
+    push_chain(first, last);
+
+    spdlog::info("[BufferPool::grow] slot size {} chunks {} huge {}", _slot_size, count + 1, huge);
+    return true;
+}
+
+unsigned char* BufferPool::acquire(uint32_t& index)
+{
+    uint64_t head = _head.load(std::memory_order_acquire);
+
+    while (true)
+    {
+        auto top = static_cast<uint32_t>(head);
+        if (top == 0)
+        {
+            if (!grow())
+            {
+                return nullptr;
+            }
+            head = _head.load(std::memory_order_acquire);
+            continue;
+        }
+
+        uint32_t next = slot_next(top - 1).load(std::memory_order_relaxed);
+        uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+
+        if (_head.compare_exchange_weak(head, new_head, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            index = top - 1;
+            break;
+        }
+    }
+
+    _hits.fetch_add(1, std::memory_order_relaxed);
+
+    int64_t in_use = _in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+    int64_t peak = _peak_in_use.load(std::memory_order_relaxed);
+    while (in_use > peak && !_peak_in_use.compare_exchange_weak(peak, in_use, std::memory_order_relaxed)) {}
+
+    return slot_address(index);
+}
+
+void BufferPool::release(uint32_t index)
+{
+    push_chain(index, index);
+    _in_use.fetch_sub(1, std::memory_order_relaxed);
+}
+
+std::string BufferPool::report() const
+{
+    std::ostringstream out;
+
+    uint64_t hits = _hits.load(std::memory_order_relaxed);
+    uint64_t misses = _misses.load(std::memory_order_relaxed);
+    double hit_rate = (hits + misses) ? 100.0 * static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+
+    size_t chunks = _chunk_count.load(std::memory_order_relaxed);
+    int64_t peak = _peak_in_use.load(std::memory_order_relaxed);
+
+    out << "pool slot " << _slot_size << " hits " << hits << " misses " << misses << " (" << hit_rate << "% hit rate)"
+        << " in use " << _in_use.load(std::memory_order_relaxed)
+        << " peak " << peak << " (" << (static_cast<double>(peak) * _slot_size / (1024 * 1024)) << " MB)"
+        << " footprint " << (chunks * POOL_CHUNK_SIZE / (1024 * 1024)) << " MB"
+        << " huge chunks " << _huge_chunks.load(std::memory_order_relaxed) << "/" << chunks;
+
+    return out.str();
+}
+
+PoolBuffer::~PoolBuffer()
+{
+    reset();
+}
+
+PoolBuffer PoolBuffer::allocate(size_t size)
+{
+    PoolBuffer buffer;
+
+    if (size == 0)
+    {
+        return buffer;
+    }
+
+    BufferPool* pool = BufferPool::for_size(size);
+    if (pool != nullptr)
+    {
+        buffer._data = pool->acquire(buffer._index);
+        if (buffer._data != nullptr)
+        {
+            buffer._pool = pool;
+            return buffer;
+        }
+        pool->count_miss();
+    }
+
+    buffer._data = new unsigned char[size];
+    return buffer;
+}
+
+PoolBuffer::PoolBuffer(PoolBuffer&& other) noexcept : _data(other._data), _pool(other._pool), _index(other._index)
+{
+    other._data = nullptr;
+    other._pool = nullptr;
+}
+
+PoolBuffer& PoolBuffer::operator=(PoolBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+
+        _data = other._data;
+        _pool = other._pool;
+        _index = other._index;
+
+        other._data = nullptr;
+        other._pool = nullptr;
+    }
+    return *this;
+}
+
+void PoolBuffer::reset()
+{
+    if (_data == nullptr)
+    {
+        return;
+    }
+
+    if (_pool != nullptr)
+    {
+        _pool->release(_index);
+    }
+    else
+    {
+        delete[] _data;
+    }
+
+    _data = nullptr;
+    _pool = nullptr;
+}
@@ -0,0 +1,101 @@
+/*
+ * buffer_pool.h — Fixed-Size Fragment Buffer Pool
+ *
+ * Slots are carved from 2 MB chunks (optionally backed by huge pages), aligned to cache line,
+ * and recycled through lock-free tagged freelist, so receiving thread and consumer thread
+ * can acquire and release without locks. Chunks are only added, never returned, while
+ * process lives. Buffers larger than biggest class or acquired from exhausted pool
+ * fall back to heap and are counted as misses.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <sys/mman.h>
+#include <spdlog/spdlog.h>
+
+#define POOL_CACHE_LINE         64
+#define POOL_CHUNK_SIZE         (2 * 1024 * 1024)   // One x86-64 huge page
+#define POOL_MAX_CHUNKS         1024                // Up to 2 GB per size class
+
+#define POOL_SMALL_SLOT_SIZE    2048                // Standard Ethernet fragment
+#define POOL_LARGE_SLOT_SIZE    65536               // Jumbo and loopback fragments
+
+class BufferPool {
+public:
+    BufferPool(size_t slot_size, size_t max_chunks);
+    ~BufferPool();
+
+    /* Smallest size class fitting size, nullptr if none */
+    static BufferPool* for_size(size_t size);
+
+    static void set_huge_pages(bool enabled);
+    static std::string report_all();
+
+    unsigned char* acquire(uint32_t& index);    // nullptr when exhausted
+    void release(uint32_t index);
+
+    [[nodiscard]] size_t get_slot_size() const { return _slot_size; }
+
+    void count_miss() { _misses.fetch_add(1, std::memory_order_relaxed); }
+    std::string report() const;
+
+    /* Copy protection */
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+private:
+    bool grow();
+    unsigned char* slot_address(uint32_t index) const;
+    std::atomic_ref<uint32_t> slot_next(uint32_t index) const;
+    void push_chain(uint32_t first, uint32_t last);
+
+    size_t _slot_size;
+    size_t _slots_per_chunk;
+    size_t _max_chunks;
+
+    /* Freelist head: high 32 bits ABA tag, low 32 bits slot index + 1 (0 is empty) */
+    alignas(POOL_CACHE_LINE) std::atomic<uint64_t> _head{0};
+
+    alignas(POOL_CACHE_LINE) std::atomic<unsigned char*>* _chunks;
+    std::atomic<size_t> _chunk_count{0};
+    std::mutex _grow_mutex;
+
+    /* Statistics */
+    alignas(POOL_CACHE_LINE) std::atomic<uint64_t> _hits{0};
+    std::atomic<uint64_t> _misses{0};
+    std::atomic<int64_t> _in_use{0};
+    std::atomic<int64_t> _peak_in_use{0};
+    std::atomic<size_t> _huge_chunks{0};
+
+    static std::atomic<bool> _huge_pages;
+};
+
+/* Owning handle to fragment buffer, returns it to pool (or heap) on destruction */
+class PoolBuffer {
+public:
+    PoolBuffer() = default;
+    ~PoolBuffer();
+
+    static PoolBuffer allocate(size_t size);
+
+    PoolBuffer(PoolBuffer&& other) noexcept;
+    PoolBuffer& operator=(PoolBuffer&& other) noexcept;
+
+    /* Copy protection */
+    PoolBuffer(const PoolBuffer&) = delete;
+    PoolBuffer& operator=(const PoolBuffer&) = delete;
+
+    [[nodiscard]] unsigned char* data() const { return _data; }
+    void reset();
+
+private:
+    unsigned char* _data = nullptr;
+    BufferPool* _pool = nullptr;        // nullptr when heap allocated
+    uint32_t _index = 0;
+};
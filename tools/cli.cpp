@@ -4,7 +4,7 @@
 
 #include "cli.h"
 
-CLI::CLI(Node* node) : _node(node)
+CLI::CLI(Host* host) : _host(host), _node(host->get_selected())
 {
     read_history(CLI_HISTORY_FILE_NAME);
 }
@@ -35,7 +35,7 @@ void CLI::run()
         if (command.substr(0, 15) == "proc node port ")
         {
             int port = std::stoi(command.substr(15));
-            _node->set_port(port);
+            _host->set_port(port);
         }
 
         else if (command.substr(0, 15) == "proc node dest ")
@@ -51,7 +51,7 @@ void CLI::run()
                 in_addr dest_ip{};
                 if (inet_pton(AF_INET, ip.c_str(), &dest_ip) == 1)
                 {
-                    _node->set_dest(dest_ip, port);
+                    _node = _host->select_peer(dest_ip, port);
                 }
                 else
                 {
@@ -66,7 +66,7 @@ void CLI::run()
             try {
                 size_t size = std::stoul(command.substr(20));
 
-                if (size > 0 && size <= TCU_MAX_PAYLOAD_LEN)
+                if (size > 0 && size <= TCU_MAX_PROBE_LEN)
                 {
                     _node->set_max_frag_size(size);
                 }
@@ -101,6 +101,216 @@ void CLI::run()
             }
         }
 
+        else if (command.substr(0, 22) == "proc node recv buffer ")
+        {
+            try {
+                size_t size = std::stoul(command.substr(22));
+
+                if (size >= TCU_MAX_PAYLOAD_LEN)
+                {
+                    _node->set_receive_buffer(size);
+                }
+                else
+                {
+                    std::cout << "invalid receive buffer size" << std::endl;
+                }
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid receive buffer size" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 21) == "proc node batch size ")
+        {
+            try {
+                size_t size = std::stoul(command.substr(21));
+
+                if (size > 0 && size <= SOCKET_MAX_BATCH)
+                {
+                    _host->set_batch_size(size);
+                }
+                else
+                {
+                    std::cout << "invalid batch size" << std::endl;
+                }
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid batch size" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 18) == "proc node offload ")
+        {
+            std::string state = command.substr(18);
+
+            if (state == "on" || state == "off")
+            {
+                _host->set_offload(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid offload state" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 22) == "proc node file direct ")
+        {
+            std::string state = command.substr(22);
+
+            if (state == "on" || state == "off")
+            {
+                _node->set_direct_file(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid direct file state" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 15) == "proc node pmtu ")
+        {
+            std::string state = command.substr(15);
+
+            if (state == "on" || state == "off")
+            {
+                _node->set_path_probing(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid path mtu discovery state" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 17) == "proc node shards ")
+        {
+            try {
+                size_t count = std::stoul(command.substr(17));
+
+                if (count > 0 && count <= HOST_MAX_SHARDS)
+                {
+                    _host->set_shards(count);
+                }
+                else
+                {
+                    std::cout << "invalid shard count" << std::endl;
+                }
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid shard count" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 18) == "proc node workers ")
+        {
+            try {
+                size_t count = std::stoul(command.substr(18));
+
+                if (count <= EXECUTOR_MAX_WORKERS)
+                {
+                    _host->set_workers(count);
+                }
+                else
+                {
+                    std::cout << "invalid worker count" << std::endl;
+                }
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid worker count" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 19) == "proc node transmit ")
+        {
+            std::string state = command.substr(19);
+
+            if (state == "on" || state == "off")
+            {
+                _host->set_transmitter(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid transmit state" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 17) == "proc node accept ")
+        {
+            std::string state = command.substr(17);
+
+            if (state == "on" || state == "off")
+            {
+                _host->set_accepting(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid accept state" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 16) == "proc node uring ")
+        {
+            std::string state = command.substr(16);
+
+            if (state == "on" || state == "off")
+            {
+                _host->set_uring(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid io_uring state" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 20) == "proc node pace rate ")
+        {
+            try {
+                double mbps = std::stod(command.substr(20));
+
+                if (mbps >= 0.0)
+                {
+                    // Megabits per second to bytes per second, 0 removes ceiling
+                    _node->set_rate_ceiling(static_cast<uint64_t>(mbps * 1000000.0 / 8.0));
+                }
+                else
+                {
+                    std::cout << "invalid pacing rate" << std::endl;
+                }
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid pacing rate" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 21) == "proc node pace burst ")
+        {
+            try {
+                size_t packets = std::stoul(command.substr(21));
+
+                if (packets > 0 && packets <= PACER_MAX_BURST)
+                {
+                    _node->set_pacing_burst(packets);
+                }
+                else
+                {
+                    std::cout << "invalid pacing burst" << std::endl;
+                }
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid pacing burst" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 13) == "proc node cc ")
+        {
+            _node->set_congestion_control(command.substr(13));
+        }
+
         else if (command == "proc node window dynamic")
         {
             _node->set_dynamic_window();
@@ -112,6 +322,20 @@ void CLI::run()
             _node->set_path(path);
         }
 
+        else if (command.substr(0, 25) == "proc node pool hugepages ")
+        {
+            std::string state = command.substr(25);
+
+            if (state == "on" || state == "off")
+            {
+                BufferPool::set_huge_pages(state == "on");
+            }
+            else
+            {
+                std::cout << "invalid huge pages state" << std::endl;
+            }
+        }
+
         else if (command == "proc node connect")
         {
             _node->send_tcu_conn_req();
@@ -124,8 +348,7 @@ void CLI::run()
 
         else if (command == "exit")
         {
-            _node->stop_receiving();
-            _node->stop_keep_alive();
+            _host->stop_receiving();
 
             break;
         }
@@ -141,6 +364,25 @@ void CLI::run()
             std::cout << logs << std::endl;
         }
 
+        else if (command == "show stats")
+        {
+            std::cout << Stats::get_instance().report() << std::endl;
+            std::cout << BufferPool::report_all() << std::endl;
+            std::cout << _node->get_pacer().report() << std::endl;
+            std::cout << _node->get_congestion_report() << std::endl;
+            std::cout << _host->report() << std::endl;
+        }
+
+        else if (command == "show peers")
+        {
+            std::cout << _host->report_peers() << std::endl;
+        }
+
+        else if (command == "reset stats")
+        {
+            Stats::get_instance().reset();
+        }
+
         else if (command.substr(0, 14) == "set log level ")
         {
             std::string level_str = command.substr(14);
@@ -180,6 +422,50 @@ void CLI::run()
             _node->send_file(file_path);
         }
 
+        else if (command == "bench crc")
+        {
+            Bench::crc();
+        }
+
+        else if (command == "bench reorder")
+        {
+            Bench::reorder();
+        }
+
+        else if (command.substr(0, 12) == "bench peers ")
+        {
+            try {
+                // Optional receive shards and protocol workers of accepting host
+                std::istringstream args(command.substr(12));
+                size_t count = 0;
+                size_t shards = 1;
+                size_t workers = 0;
+
+                if (!(args >> count))
+                {
+                    throw std::invalid_argument("count");
+                }
+                args >> shards >> workers;
+
+                Bench::peers(count, shards, workers);
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid peer count" << std::endl;
+            }
+        }
+
+        else if (command.substr(0, 9) == "bench io ")
+        {
+            try {
+                Bench::io(std::stoul(command.substr(9)));
+            }
+            catch(std::exception&)
+            {
+                std::cout << "invalid batch size" << std::endl;
+            }
+        }
+
         else if (command.substr(0, 15) == "set error rate ")
         {
             try {
@@ -225,11 +511,25 @@ void CLI::run()
 void CLI::display_help() {
     std::cout << "commands:\n"
               << "  proc node port <port>           - set source node port will listen\n"
-              << "  proc node dest <ip>:<port>      - set destination node ip and port\n"
-              << "  proc node frag size <size>      - set maximum fragment size in bytes (0," << TCU_MAX_PAYLOAD_LEN << ")\n"
+              << "  proc node dest <ip>:<port>      - set destination node ip and port, selects its connection for next commands\n"
+              << "  proc node shards <count>        - receive on count SO_REUSEPORT sockets with own threads, set before port (1," << HOST_MAX_SHARDS << ")\n"
+              << "  proc node workers <count>       - process datagrams on count work-stealing threads, set before port, 0 inline (0," << EXECUTOR_MAX_WORKERS << ")\n"
+              << "  proc node transmit <on|off>     - queue outgoing datagrams to one sending thread, set before port\n"
+              << "  proc node accept <on|off>       - accept connection requests from unknown peers (default on)\n"
+              << "  proc node frag size <size>      - set maximum fragment size in bytes (0," << TCU_MAX_PROBE_LEN << "), capped by probed path\n"
               << "  proc node window size <size>    - set manual window size (disable dynamic window sizing)\n"
               << "  proc node window dynamic        - enable dynamic window sizing\n"
+              << "  proc node recv buffer <bytes>   - set receive buffer budget for out-of-order fragments, advertised to sender\n"
+              << "  proc node batch size <size>     - set datagrams per sendmmsg/recvmmsg, 1 disables batching (1," << SOCKET_MAX_BATCH << ")\n"
+              << "  proc node offload <on|off>      - send windows with udp gso and receive with udp gro\n"
+              << "  proc node pmtu <on|off>         - probe path after connect, fragment size grows to largest datagram path carries\n"
+              << "  proc node uring <on|off>        - use io_uring backend, falls back to epoll when kernel lacks support\n"
+              << "  proc node pace rate <mbit/s>    - set pacing rate ceiling, 0 follows measured delivery rate only\n"
+              << "  proc node pace burst <packets>  - set packets released back to back (1," << PACER_MAX_BURST << ")\n"
+              << "  proc node cc <name>             - set congestion control (none, reno, delay)\n"
               << "  proc node file path <path>      - set file save path for received files (default " << _node->get_path() << ")\n"
+              << "  proc node file direct <on|off>  - write received files to disk as fragments arrive instead of assembling in memory\n"
+              << "  proc node pool hugepages <on|off> - back fragment buffer pool with huge pages\n"
               << "\n"
               << "  proc node connect               - connect to destination node\n"
               << "  proc node disconnect            - disconnect with destination node\n"
@@ -239,11 +539,19 @@ void CLI::display_help() {
               << "\n"
               << "  set log level <level>           - set log level (trace, debug, info, warn, error, critical)\n"
               << "  show log                        - display current logs\n"
+              << "  show stats                      - display hot path counters\n"
+              << "  show peers                      - display connection table, selected peer marked with *\n"
+              << "  reset stats                     - reset hot path counters\n"
               << "\n"
               << "  set error rate <rate>           - set chance of corrupted packet (0,100)\n"
               << "  set packet loss rate <rate>     - set chance of lost packet (0,100)\n"
               << "  set window loss rate <rate>     - set chance of lost window (0,100)\n"
               << "\n"
+              << "  bench crc                       - verify and measure crc16 variants throughput\n"
+              << "  bench io <batch>                - compare per-datagram, batched and gso/gro socket i/o on loopback\n"
+              << "  bench reorder                   - compare receive path over std::map and sequence ring reorder buffer\n"
+              << "  bench peers <count> [shards] [workers] - aggregate throughput of 1 to count peers sending to one host at once\n"
+              << "\n"
               << "  exit                            - exit application\n"
               << "\n";
 }
@@ -6,24 +6,29 @@
 
 #include <iostream>
 #include <string>
+#include <sstream>
 #include <readline/readline.h>
 #include <readline/history.h>
 
 #include "logger.h"
+#include "bench.h"
+#include "stats.h"
+#include "buffer_pool.h"
 #include "../version.h"
-#include "../entities/node.h"
+#include "../entities/host.h"
 
 #define CLI_HISTORY_FILE_NAME ".cli_history"
 
 class CLI {
 public:
-    explicit CLI(Node* node);
+    explicit CLI(Host* host);
     ~CLI();
 
     void run();
 
 private:
-    Node* _node;
+    Host* _host;
+    Node* _node;                    // Selected peer
     void display_help();
     static void display_header();
 };
@@ -0,0 +1,120 @@
+/*
+ * stats.cpp
+ */
+
+#include "stats.h"
+
+#ifdef STATS_COUNT_ALLOCS
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local uint64_t alloc_count = 0;
+}
+
+/* Counting replacements of global allocation functions, whole process allocates through them */
+void* operator new(std::size_t size)
+{
+    alloc_count++;
+
+    if (size == 0)
+    {
+        size = 1;
+    }
+
+    if (void* ptr = std::malloc(size))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+uint64_t thread_alloc_count()
+{
+    return alloc_count;
+}
+
+#else
+
+uint64_t thread_alloc_count()
+{
+    return 0;
+}
+
+#endif
+
+Stats& Stats::get_instance()
+{
+    static Stats instance;
+    return instance;
+}
+
+void Stats::reset()
+{
+    tx_packets = 0;
+    tx_allocs = 0;
+    tx_syscalls = 0;
+
+    rx_packets = 0;
+    rx_allocs = 0;
+    rx_copies = 0;
+    rx_syscalls = 0;
+}
+
+std::string Stats::report() const
+{
+    std::ostringstream out;
+
+    auto per_packet = [](uint64_t count, uint64_t packets) {
+        return packets ? static_cast<double>(count) / static_cast<double>(packets) : 0.0;
+    };
+
+    uint64_t tx = tx_packets.load(std::memory_order_relaxed);
+    out << "tx packets " << tx;
+#ifdef STATS_COUNT_ALLOCS
+    out << " allocs " << tx_allocs.load(std::memory_order_relaxed)
+        << " (" << per_packet(tx_allocs.load(std::memory_order_relaxed), tx) << " per packet)";
+#endif
+    out << " syscalls " << tx_syscalls.load(std::memory_order_relaxed)
+        << " (" << per_packet(tx_syscalls.load(std::memory_order_relaxed), tx) << " per packet)\n";
+
+    uint64_t rx = rx_packets.load(std::memory_order_relaxed);
+    out << "rx packets " << rx;
+#ifdef STATS_COUNT_ALLOCS
+    out << " allocs " << rx_allocs.load(std::memory_order_relaxed)
+        << " (" << per_packet(rx_allocs.load(std::memory_order_relaxed), rx) << " per packet)";
+#endif
+    out << " payload copies " << rx_copies.load(std::memory_order_relaxed)
+        << " (" << per_packet(rx_copies.load(std::memory_order_relaxed), rx) << " per packet)"
+        << " syscalls " << rx_syscalls.load(std::memory_order_relaxed)
+        << " (" << per_packet(rx_syscalls.load(std::memory_order_relaxed), rx) << " per packet)";
+
+    return out.str();
+}
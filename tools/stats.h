@@ -0,0 +1,35 @@
+/*
+ * stats.h
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <sstream>
+
+/* Number of heap allocations (operator new) made by calling thread so far, 0 unless built with ALLOC_STATS */
+uint64_t thread_alloc_count();
+
+class Stats {
+public:
+    static Stats& get_instance();
+
+    void reset();
+    std::string report() const;
+
+    /* Transmit path */
+    std::atomic<uint64_t> tx_packets{0};
+    std::atomic<uint64_t> tx_allocs{0};         // Allocations inside serialization and send
+    std::atomic<uint64_t> tx_syscalls{0};
+
+    /* Receive path */
+    std::atomic<uint64_t> rx_packets{0};
+    std::atomic<uint64_t> rx_allocs{0};         // Allocations inside parsing and processing
+    std::atomic<uint64_t> rx_copies{0};         // Payload copies of received fragments
+    std::atomic<uint64_t> rx_syscalls{0};
+
+private:
+    Stats() = default;
+};
@@ -0,0 +1,205 @@
+/*
+ * seq_ring — Sequence Indexed Ring With Presence Bitmap
+ *
+ * Holds elements for sequence numbers [base, base + capacity). Slot is sequence
+ * number masked by capacity (power of two), presence of every slot is one bit,
+ * so insert, lookup and duplicate detection are O(1), and gaps are found by
+ * scanning 64 slots per word. Advancing base releases elements in order.
+ * Storage can be deferred until first use, unallocated ring has no range and
+ * holds nothing.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+template <typename T>
+class seq_ring {
+public:
+    explicit seq_ring(size_t capacity, bool allocated = true) : _mask(round_up(capacity) - 1)
+    {
+        if (allocated)
+        {
+            allocate();
+        }
+    }
+
+    /* Creates slots and bitmap once, later calls keep contents */
+    void allocate()
+    {
+        if (_slots.empty())
+        {
+            _slots.resize(_mask + 1);
+            _present.assign((_mask + 1) / 64, 0);
+        }
+    }
+
+    [[nodiscard]] bool allocated() const { return !_slots.empty(); }
+    [[nodiscard]] size_t capacity() const { return _slots.size(); }
+    [[nodiscard]] size_t size() const { return _count; }
+    [[nodiscard]] bool empty() const { return _count == 0; }
+    [[nodiscard]] uint32_t base() const { return _base; }
+
+    /* Drops all elements, window starts at base */
+    void reset(uint32_t base)
+    {
+        if (_count > 0)
+        {
+            for (size_t word = 0; word < _present.size(); word++)
+            {
+                for (uint64_t bits = _present[word]; bits != 0; bits &= bits - 1)
+                {
+                    _slots[word * 64 + __builtin_ctzll(bits)] = T{};
+                }
+                _present[word] = 0;
+            }
+        }
+        _count = 0;
+        _base = base;
+    }
+
+    [[nodiscard]] bool in_range(uint32_t seq) const { return seq - _base < capacity(); }
+
+    [[nodiscard]] bool contains(uint32_t seq) const
+    {
+        return in_range(seq) && test(seq & _mask);
+    }
+
+    T* find(uint32_t seq)
+    {
+        return contains(seq) ? &_slots[seq & _mask] : nullptr;
+    }
+
+    /* Sequence must be in range, existing element is replaced */
+    T& insert(uint32_t seq, T&& value)
+    {
+        size_t slot = seq & _mask;
+        if (!test(slot))
+        {
+            set(slot);
+            _count++;
+        }
+        _slots[slot] = std::move(value);
+        return _slots[slot];
+    }
+
+    void erase(uint32_t seq)
+    {
+        if (!contains(seq))
+        {
+            return;
+        }
+
+        size_t slot = seq & _mask;
+        _slots[slot] = T{};
+        clear(slot);
+        _count--;
+    }
+
+    /* Moves base past seq, handler sees every present element on the way, in order */
+    template <typename Handler>
+    void release_until(uint32_t seq, Handler&& handler)
+    {
+        while (static_cast<int32_t>(seq - _base) >= 0)
+        {
+            if (_count == 0)
+            {
+                _base = seq + 1;
+                return;
+            }
+
+            size_t slot = _base & _mask;
+            if (test(slot))
+            {
+                handler(_base, _slots[slot]);
+                _slots[slot] = T{};
+                clear(slot);
+                _count--;
+            }
+            _base++;
+        }
+    }
+
+    /* Consumes contiguous run starting at base */
+    template <typename Handler>
+    void drain(Handler&& handler)
+    {
+        while (_count > 0 && test(_base & _mask))
+        {
+            size_t slot = _base & _mask;
+            handler(_base, _slots[slot]);
+            _slots[slot] = T{};
+            clear(slot);
+            _count--;
+            _base++;
+        }
+    }
+
+    /* Missing sequence numbers in [from, to], limited to ring range */
+    template <typename Handler>
+    void for_each_missing(uint32_t from, uint32_t to, Handler&& handler) const
+    {
+        uint32_t end = std::min<uint32_t>(to, _base + static_cast<uint32_t>(capacity()) - 1);
+        uint32_t seq = std::max(from, _base);
+
+        while (static_cast<int32_t>(end - seq) >= 0)
+        {
+            size_t slot = seq & _mask;
+            size_t bit = slot % 64;
+
+            // Whole word at once, set bits are present fragments
+            uint64_t missing = ~_present[slot / 64] >> bit;
+            uint32_t span = std::min<uint32_t>(64 - bit, end - seq + 1);
+            if (span < 64)
+            {
+                missing &= (uint64_t(1) << span) - 1;
+            }
+
+            for (; missing != 0; missing &= missing - 1)
+            {
+                handler(seq + __builtin_ctzll(missing));
+            }
+            seq += span;
+        }
+    }
+
+    /* Present elements in sequence order */
+    template <typename Handler>
+    void for_each(Handler&& handler)
+    {
+        for (uint32_t seq = _base, seen = 0; seen < _count; seq++)
+        {
+            if (test(seq & _mask))
+            {
+                handler(seq, _slots[seq & _mask]);
+                seen++;
+            }
+        }
+    }
+
+private:
+    static size_t round_up(size_t capacity)
+    {
+        size_t size = 64;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    [[nodiscard]] bool test(size_t slot) const { return (_present[slot / 64] >> (slot % 64)) & 1; }
+    void set(size_t slot) { _present[slot / 64] |= uint64_t(1) << (slot % 64); }
+    void clear(size_t slot) { _present[slot / 64] &= ~(uint64_t(1) << (slot % 64)); }
+
+    std::vector<T> _slots;
+    std::vector<uint64_t> _present;
+    size_t _mask;
+
+    uint32_t _base = 1;
+    size_t _count = 0;
+};
@@ -0,0 +1,109 @@
+/*
+ * spsc_ring — Lock-Free Single Producer Single Consumer Ring
+ *
+ * Bounded queue between two pipeline stages. Producer owns tail and consumer
+ * owns head, each index sits on own cache line together with owner's cached copy
+ * of other index, so shared lines are only touched when cached copy says ring
+ * looks full or empty. Batch operations publish many elements with one store.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#define SPSC_CACHE_LINE         64
+
+template <typename T>
+class spsc_ring {
+public:
+    explicit spsc_ring(size_t capacity) : _slots(round_up(capacity)), _mask(round_up(capacity) - 1) {}
+
+    [[nodiscard]] size_t capacity() const { return _slots.size(); }
+
+    /* Either side, exact only when other side is idle */
+    [[nodiscard]] size_t size() const
+    {
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+    [[nodiscard]] bool empty() const { return size() == 0; }
+
+    /* Producer side, false when full */
+    bool push(T&& item)
+    {
+        return push_batch(&item, 1) == 1;
+    }
+
+    /* Producer side, moves leading elements that fit, returns their count */
+    size_t push_batch(T* items, size_t count)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+
+        size_t free = capacity() - (tail - _head_cache);
+        if (free < count)
+        {
+            _head_cache = _head.load(std::memory_order_acquire);
+            free = capacity() - (tail - _head_cache);
+        }
+
+        size_t pushed = std::min(free, count);
+        for (size_t i = 0; i < pushed; i++)
+        {
+            _slots[(tail + i) & _mask] = std::move(items[i]);
+        }
+
+        _tail.store(tail + pushed, std::memory_order_release);
+        return pushed;
+    }
+
+    /* Consumer side, returns number of elements moved out */
+    size_t pop_batch(T* out, size_t count)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+
+        size_t available = _tail_cache - head;
+        if (available < count)
+        {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            available = _tail_cache - head;
+        }
+
+        size_t popped = std::min(available, count);
+        for (size_t i = 0; i < popped; i++)
+        {
+            out[i] = std::move(_slots[(head + i) & _mask]);
+        }
+
+        _head.store(head + popped, std::memory_order_release);
+        return popped;
+    }
+
+    /* Copy protection */
+    spsc_ring(const spsc_ring&) = delete;
+    spsc_ring& operator=(const spsc_ring&) = delete;
+
+private:
+    static size_t round_up(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    /* Producer line */
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> _tail{0};
+    size_t _head_cache = 0;
+
+    /* Consumer line */
+    alignas(SPSC_CACHE_LINE) std::atomic<size_t> _head{0};
+    size_t _tail_cache = 0;
+
+    alignas(SPSC_CACHE_LINE) std::vector<T> _slots;
+    size_t _mask;
+};
@@ -9,6 +9,9 @@ fields.seq_num = ProtoField.uint24("tcu.seq_num", "Sequence Number", base.DEC)
 fields.flags = ProtoField.uint8("tcu.flags", "Flags", base.HEX)
 fields.length = ProtoField.uint16("tcu.length", "Payload Length", base.DEC)
 fields.checksum = ProtoField.uint16("tcu.checksum", "Checksum", base.HEX)
+fields.window = ProtoField.uint24("tcu.window", "Receive Window", base.DEC)
+fields.missing = ProtoField.bytes("tcu.missing", "Missing Fragments Bitmap")
+fields.probed = ProtoField.uint16("tcu.probed", "Probed Length", base.DEC)
 
 -- Flags definitions
 local SYN  = 0x01
@@ -74,6 +77,23 @@ function tcu_proto.dissector(buffer, pinfo, tree)
     subtree:add(fields.checksum, checksum_field)
     offset = offset + 2
 
+    -- Receive Window (3 bytes, ACK and NACK payload)
+    if (has_flag(ACK) or has_flag(NACK)) and not (has_flag(SYN) or has_flag(FIN) or has_flag(KA)) and length >= 3 and buffer:len() >= offset + 3 then
+        subtree:add(fields.window, buffer(offset, 3))
+
+        -- Missing fragments after sequence number (NACK only)
+        if has_flag(NACK) and length > 3 and buffer:len() >= offset + length then
+            subtree:add(fields.missing, buffer(offset + 3, length - 3))
+        end
+    end
+
+    -- Probed Length (2 bytes, path probe acknowledgment payload)
+    local probed = 0
+    if has_flag(KA) and has_flag(ACK) and length == 2 and buffer:len() >= offset + 2 then
+        probed = buffer(offset, 2):uint()
+        subtree:add(fields.probed, buffer(offset, 2))
+    end
+
     -- Determine packet type
     local info_str = string.format("%d → %d ", pinfo.src_port, pinfo.dst_port)
 
@@ -87,11 +107,15 @@ function tcu_proto.dissector(buffer, pinfo, tree)
         info_str = info_str .. "Disconnection Request"
     elseif has_flag(KA) and has_flag(ACK) and length == 0 then
         info_str = info_str .. "Keep-Alive Acknowledgment"
+    elseif has_flag(KA) and has_flag(ACK) and length == 2 then
+        info_str = info_str .. "Path Probe Acknowledgment " .. tostring(probed)
     elseif has_flag(KA) and length == 0 then
         info_str = info_str .. "Keep-Alive Request"
-    elseif has_flag(ACK) and length == 0 then
+    elseif has_flag(KA) and not has_flag(ACK) then
+        info_str = info_str .. "Path Probe " .. tostring(length)
+    elseif has_flag(ACK) and (length == 0 or length == 3) then
         info_str = info_str .. "Positive Acknowledgment " .. tostring(seq_num)
-    elseif has_flag(NACK) and length == 0 then
+    elseif has_flag(NACK) then
         info_str = info_str .. "Negative Acknowledgment " .. tostring(seq_num)
     elseif has_flag(DF) and has_flag(FL) then
         info_str = info_str .. "Single File Message"